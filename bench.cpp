@@ -0,0 +1,555 @@
+#include "header.h"
+#include <signal.h>
+#include <sys/wait.h>
+#include <sched.h>
+
+// Microbenchmarks, built and run by `make bench`.
+// Each benchmark repeats its body until BENCH_MIN_NS elapsed and reports the cost of one call:
+// time, syscalls and allocations. The readers are also measured cold, on their first call in a
+// fresh process, and with more processes and interfaces than the machine has.
+
+static const long long BENCH_MIN_NS = 200000000LL;
+
+// written by the benchmarks so the compiler cannot drop their work
+static volatile long long bench_sink;
+
+// Average cost of one call of a benchmarked function.
+struct Cost
+{
+    double ns;
+    double syscalls;    // counted by the procfs layer, see countSyscalls()
+    double allocations; // operator new calls
+};
+
+/**
+ * Runs fn until BENCH_MIN_NS elapsed, after one warm-up call.
+ *
+ * @return The average cost of one warm call.
+ */
+template <typename F>
+static Cost measure(F fn)
+{
+    fn();
+    long long iterations = 0;
+    unsigned long long syscalls = syscall_count.load();
+    unsigned long long allocations = allocationCount();
+    long long start = monotonicNs();
+    long long elapsed;
+    do
+    {
+        for (int i = 0; i < 64; i++)
+            fn();
+        iterations += 64;
+        elapsed = monotonicNs() - start;
+    } while (elapsed < BENCH_MIN_NS);
+    return {(double)elapsed / iterations, (double)(syscall_count.load() - syscalls) / iterations,
+            (double)(allocationCount() - allocations) / iterations};
+}
+
+/**
+ * Measures the first call of fn in a forked child. The child inherits the
+ * files, buffers and threads the caller's process already holds, so a cold
+ * measure is only cold when the process never ran the same reader: the
+ * sections that need one run in a process of their own, see runInChild().
+ *
+ * @return The cost of that one call, all zero if the child could not run.
+ */
+template <typename F>
+static Cost measureCold(F fn)
+{
+    Cost cost = {0, 0, 0};
+    int fds[2];
+    if (pipe(fds) < 0)
+        return cost;
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0)
+    {
+        close(fds[0]);
+        unsigned long long syscalls = syscall_count.load();
+        unsigned long long allocations = allocationCount();
+        long long start = monotonicNs();
+        fn();
+        cost = {(double)(monotonicNs() - start), (double)(syscall_count.load() - syscalls), (double)(allocationCount() - allocations)};
+        if (write(fds[1], &cost, sizeof(cost)) < 0)
+            _exit(1);
+        _exit(0);
+    }
+    close(fds[1]);
+    if (child > 0)
+    {
+        if (read(fds[0], &cost, sizeof(cost)) != sizeof(cost))
+            cost = {0, 0, 0};
+        waitpid(child, nullptr, 0);
+    }
+    close(fds[0]);
+    return cost;
+}
+
+// Runs fn in a forked child and waits for it: the files, buffers and threads
+// the readers keep in the child are gone for the next section.
+template <typename F>
+static void runInChild(F fn)
+{
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0)
+    {
+        fn();
+        fflush(stdout);
+        _exit(0);
+    }
+    if (child > 0)
+        waitpid(child, nullptr, 0);
+}
+
+static void report(const char *name, const Cost &cost, const char *detail = "")
+{
+    printf("%-32s %12.1f ns/op %8.1f syscalls/op %8.1f allocs/op  %s\n", name, cost.ns, cost.syscalls, cost.allocations, detail);
+}
+
+static void report(const char *name, const Cost &cost, size_t bytes)
+{
+    char detail[32];
+    snprintf(detail, sizeof(detail), "%zu bytes", bytes);
+    report(name, cost, detail);
+}
+
+// Reports the cold cost of fn, measured beforehand with measureCold(), and its warm cost.
+template <typename F>
+static void reportColdWarm(const char *name, const Cost &cold, F fn, const char *detail = "")
+{
+    char label[64];
+    snprintf(label, sizeof(label), "%s cold", name);
+    report(label, cold, detail);
+    snprintf(label, sizeof(label), "%s warm", name);
+    report(label, measure(fn), detail);
+}
+
+// Reports the cold and the warm cost of fn.
+template <typename F>
+static void reportColdWarm(const char *name, F fn, const char *detail = "")
+{
+    reportColdWarm(name, measureCold(fn), fn, detail);
+}
+
+// Reads a whole file once, benchmarks then parse the same content over and over.
+static string slurp(const char *path)
+{
+    ifstream file(path);
+    return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+// Per-file cost of the /proc parsers of parse.cpp, with the scanFields() implementation in use.
+static void benchParsers()
+{
+    printf("== parsers, scanFields: %s\n", scanFieldsBackend());
+
+    vector<CPUStats> cores;
+    string stat = slurp("/proc/stat");
+    report("parseCPUStat /proc/stat", measure([&] {
+               CPUStats cpu_s;
+               parseCPUStat(stat.data(), stat.size(), cpu_s, cores);
+               bench_sink = cpu_s.user;
+           }), stat.size());
+
+    string stat192 = syntheticStat(192);
+    report("parseCPUStat 192 cores", measure([&] {
+               CPUStats cpu_s;
+               parseCPUStat(stat192.data(), stat192.size(), cpu_s, cores);
+               bench_sink = cpu_s.user;
+           }), stat192.size());
+
+    string meminfo = slurp("/proc/meminfo");
+    report("parseMeminfo", measure([&] {
+               Memory mem;
+               parseMeminfo(meminfo.data(), meminfo.size(), mem);
+               bench_sink = mem.used_ram;
+           }), meminfo.size());
+
+    string net_dev = slurp("/proc/net/dev");
+    vector<Net> nets;
+    report("parseNetDev", measure([&] {
+               parseNetDev(net_dev.data(), net_dev.size(), nets);
+               bench_sink = nets.size();
+           }), net_dev.size());
+
+    string net_dev500 = syntheticNetDev(500);
+    report("parseNetDev 500 interfaces", measure([&] {
+               parseNetDev(net_dev500.data(), net_dev500.size(), nets);
+               bench_sink = nets.size();
+           }), net_dev500.size());
+
+    string uptime = slurp("/proc/uptime");
+    report("parseUptime", measure([&] {
+               double seconds;
+               parseUptime(uptime.data(), uptime.size(), seconds);
+               bench_sink = seconds;
+           }), uptime.size());
+
+    string pid_stat = slurp("/proc/self/stat");
+    report("parsePidStat", measure([&] {
+               Proc proc;
+               parsePidStat(pid_stat.data(), pid_stat.size(), proc);
+               bench_sink = proc.rss;
+           }), pid_stat.size());
+
+    // a name with spaces and parentheses, the worst case for the name scan
+    string tricky = "4242 (a (b) c) d) S 1 4242 4242 0 -1 4194560 120 0 0 0 12 7 0 0 20 0 1 0 5511 10579968 1321 "
+                    "18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0\n";
+    report("parsePidStat (tricky name)", measure([&] {
+               Proc proc;
+               parsePidStat(tricky.data(), tricky.size(), proc);
+               bench_sink = proc.rss;
+           }), tricky.size());
+}
+
+
+// The readers of system.cpp and mem.cpp whose cost does not depend on the machine's load.
+static void benchSystem()
+{
+    printf("== system readers\n");
+    CPUStats cpu_s;
+    vector<CPUStats> cores;
+    reportColdWarm("getCPUStats", [&] {
+        getCPUStats(cpu_s, cores);
+        bench_sink = cpu_s.user;
+    });
+    Memory mem;
+    reportColdWarm("getMemoryValues", [&] {
+        getMemoryValues(&mem);
+        bench_sink = mem.used_ram;
+    });
+    Disk disk;
+    reportColdWarm("getDiskValues", [&] {
+        getDiskValues(&disk);
+        bench_sink = disk.used;
+    });
+    reportColdWarm("getCPUTemp", [&] { bench_sink = getCPUTemp(); });
+    reportColdWarm("getSpeedFan", [&] { bench_sink = getSpeedFan().size(); });
+    reportColdWarm("getFanLevel", [&] { bench_sink = getFanLevel().size(); });
+}
+
+// Pids of every process currently in /proc.
+static vector<int> currentPids()
+{
+    vector<int> pids;
+    listPids(procDirFd(), pids);
+    return pids;
+}
+
+// Pid enumeration of /proc, getdents64 against std::filesystem.
+static void benchPidList(const char *detail)
+{
+    vector<int> pids;
+    char proc_path[PATH_MAX];
+    const char *proc_dir = rootedPath("/proc", proc_path, sizeof(proc_path));
+    report("listPids", measure([&] { bench_sink = listPids(procDirFd(), pids); }), detail);
+    report("directory_iterator", measure([&] {
+               pids.clear();
+               for (const auto &entry : filesystem::directory_iterator(proc_dir))
+               {
+                   if (entry.is_directory() && isdigit(entry.path().filename().c_str()[0]))
+                       pids.push_back(atoi(entry.path().filename().c_str()));
+               }
+               bench_sink = pids.size();
+           }), detail);
+}
+
+// One readPidStats() over every pid, with and without io_uring.
+static void benchPidScan(const vector<int> &pids, const char *detail)
+{
+    vector<Proc> processes;
+    for (bool use_io_uring : {false, true})
+    {
+        const char *name = use_io_uring ? "readPidStats io_uring" : "readPidStats sync";
+        PidScanner *scanner = createPidScanner(use_io_uring);
+        scanner->warm = true;
+        if (use_io_uring && !scanner->uring)
+            printf("%-32s unavailable\n", name);
+        else
+            report(name, measure([&] {
+                       processes.clear();
+                       readPidStats(*scanner, pids.data(), pids.size(), 0, processes);
+                       bench_sink = processes.size();
+                   }), detail);
+        destroyPidScanner(scanner);
+    }
+}
+
+/**
+ * Process scan with the processes of the machine plus extra idle children,
+ * from the pid listing to the whole updateProcessData(). Runs in a child of
+ * its own, where the cold updateProcessData() comes before any other call
+ * to the process readers.
+ *
+ * @param extra Number of paused children forked for the duration of the benchmark.
+ */
+static void benchProcesses(int extra)
+{
+    vector<pid_t> children;
+    for (int i = 0; i < extra; i++)
+    {
+        pid_t child = fork();
+        if (child < 0)
+            break;
+        if (child == 0)
+        {
+            pause();
+            _exit(0);
+        }
+        children.push_back(child);
+    }
+
+    vector<Proc> processes;
+    auto update = [&] {
+        updateProcessData(processes);
+        bench_sink = processes.size();
+    };
+    Cost cold = measureCold(update);
+    vector<int> pids = currentPids();
+    char detail[32];
+    snprintf(detail, sizeof(detail), "%zu processes", pids.size());
+    printf("== processes, %s\n", detail);
+    benchPidList(detail);
+    benchPidScan(pids, detail);
+    reportColdWarm("updateProcessData", cold, update, detail);
+    stopScanPool();
+
+    for (pid_t child : children)
+        kill(child, SIGKILL);
+    for (pid_t child : children)
+        waitpid(child, nullptr, 0);
+}
+
+// Interface counters and addresses, with the interfaces of the current network namespace.
+static void benchLinks()
+{
+    vector<Net> nets;
+    fillRXTXDatas(nets);
+    char detail[32];
+    snprintf(detail, sizeof(detail), "%zu interfaces", nets.size());
+    report("getLinkStats (rtnetlink)", measure([&] { bench_sink = getLinkStats(nets); }), detail);
+    report("readNetDev (/proc/net/dev)", measure([&] { bench_sink = readNetDev(nets); }), detail);
+    reportColdWarm("fillRXTXDatas", [&] {
+        fillRXTXDatas(nets);
+        bench_sink = nets.size();
+    }, detail);
+    Networks networks;
+    reportColdWarm("getIpv4Network", [&] {
+        networks.ip4s.clear();
+        getIpv4Network(&networks);
+        bench_sink = networks.ip4s.size();
+    }, detail);
+}
+
+/**
+ * Runs benchLinks() in a child process, so the sockets and files it opens
+ * belong to the child's network namespace.
+ *
+ * @param veth_pairs When not 0, the child moves to a new network namespace
+ *                   and creates that many veth pairs with an IPv4 address
+ *                   each first (needs root and iproute2).
+ */
+static void benchLinksIn(int veth_pairs)
+{
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0)
+    {
+        if (veth_pairs > 0)
+        {
+            FILE *ip = nullptr;
+            if (unshare(CLONE_NEWNET) == 0)
+                ip = popen("ip -batch - 2>/dev/null", "w");
+            if (ip == nullptr)
+            {
+                printf("== interfaces, %d veth pairs: cannot create a network namespace, skipped\n", veth_pairs);
+                _exit(0);
+            }
+            for (int i = 0; i < veth_pairs; i++)
+            {
+                fprintf(ip, "link add veth%d type veth peer name vethp%d\n", i, i);
+                fprintf(ip, "addr add 10.%d.%d.1/32 dev veth%d\n", i / 250, i % 250, i);
+            }
+            pclose(ip);
+        }
+        printf("== interfaces, %s\n", veth_pairs > 0 ? "new network namespace" : "host");
+        benchLinks();
+        fflush(stdout);
+        _exit(0);
+    }
+    if (child > 0)
+        waitpid(child, nullptr, 0);
+}
+
+static const Collector &collectorNamed(const char *name)
+{
+    for (const Collector &collector : collectors)
+        if (strcmp(collector.name, name) == 0)
+            return collector;
+    return collectors[0];
+}
+
+/**
+ * Process scan and interface counters on a synthetic tree written to /tmp,
+ * at sizes no test machine has. The copy into a Snapshot is what a publish
+ * costs the process and network tables, the tables themselves only draw
+ * their visible rows (run the monitor on the tree and open the Monitor
+ * overhead window for the frame time). Runs in a child of its own, the cold
+ * readers first.
+ */
+static void benchSyntheticTree(int process_count, int interface_count, int cores)
+{
+    char root[] = "/tmp/monitor_bench.XXXXXX";
+    if (mkdtemp(root) == nullptr)
+        return;
+    long long start = monotonicNs();
+    bool written = writeSyntheticTree(root, process_count, interface_count, cores);
+    printf("== synthetic tree, %d processes, %d interfaces, %d cores (written in %.0f ms)\n", process_count, interface_count,
+           cores, (monotonicNs() - start) / 1e6);
+    if (written)
+    {
+        string proc_root = string(root) + "/proc";
+        string sys_root = string(root) + "/sys";
+        setFileRoots(proc_root.c_str(), sys_root.c_str());
+
+        Snapshot state = {}, published = {};
+        auto update = [&] {
+            updateProcessData(state.processes);
+            bench_sink = state.processes.size();
+        };
+        auto fill = [&] {
+            fillRXTXDatas(state.nets);
+            bench_sink = state.nets.size();
+        };
+        Cost cold_update = measureCold(update);
+        Cost cold_fill = measureCold(fill);
+        char detail[32];
+        snprintf(detail, sizeof(detail), "%d processes", process_count);
+        benchPidList(detail);
+        reportColdWarm("updateProcessData", cold_update, update, detail);
+        const Collector &process_collector = collectorNamed("processes");
+        report("processes publish copy", measure([&] { process_collector.copy(state, published); }), detail);
+        stopScanPool();
+
+        snprintf(detail, sizeof(detail), "%d interfaces", interface_count);
+        reportColdWarm("fillRXTXDatas", cold_fill, fill, detail);
+        const Collector &network_collector = collectorNamed("network");
+        report("network publish copy", measure([&] { network_collector.copy(state, published); }), detail);
+        setFileRoots("/proc", "/sys");
+    }
+    else
+        printf("cannot write the tree, skipped\n");
+    removeTree(root);
+}
+
+/**
+ * Runs every collector 20 times on a thread of its own, into a private
+ * Snapshot, and compares the average run with the collector's cost estimate.
+ */
+static void benchCollectors()
+{
+    const int RUNS = 20;
+    printf("== collectors (%d runs each, on a separate thread)\n", RUNS);
+    for (const Collector &collector : collectors)
+    {
+        Snapshot state = {};
+        CollectorStats stats = {collector.name, collector.period_ms, collector.cost_ms, 0, 0, 0, 0, 0, 0};
+        double total_ms = 0;
+        unsigned long long syscalls = 0;
+        thread([&] {
+            for (int i = 0; i < RUNS; i++)
+            {
+                timeCollector(collector, state, stats);
+                total_ms += stats.last_duration_ms;
+                syscalls += stats.syscalls;
+            }
+        }).join();
+        printf("%-12s %9.3f ms/run %6.1f syscalls/run   estimate %.3f ms%s\n", collector.name, total_ms / RUNS,
+               (double)syscalls / RUNS, collector.cost_ms, total_ms / RUNS > collector.cost_ms ? "  OVER" : "");
+    }
+}
+
+/**
+ * Runs every collector once per frame of the replayed capture, on this
+ * thread, and reports their average and worst run. The files come from
+ * memory, so this measures the parsing and the processing of the captured
+ * host, not its kernel.
+ */
+static void benchReplay()
+{
+    Snapshot state = {};
+    CollectorStats stats[COLLECTOR_COUNT] = {};
+    double total_ms[COLLECTOR_COUNT] = {};
+    float max_ms[COLLECTOR_COUNT] = {};
+    unsigned long long allocations[COLLECTOR_COUNT] = {};
+    while (advanceFixtures())
+    {
+        for (int i = 0; i < COLLECTOR_COUNT; i++)
+        {
+            unsigned long long before = allocationCount();
+            timeCollector(collectors[i], state, stats[i]);
+            allocations[i] += allocationCount() - before;
+            total_ms[i] += stats[i].last_duration_ms;
+            max_ms[i] = max(max_ms[i], stats[i].last_duration_ms);
+        }
+    }
+    double seconds;
+    unsigned long long frames = replayPosition(seconds);
+    printf("== replay of %s: %llu frames over %.1f s, %d processes in the last one\n", monitor_config.replay, frames, seconds,
+           state.process_count);
+    if (frames == 0)
+        return;
+    for (int i = 0; i < COLLECTOR_COUNT; i++)
+        printf("%-12s %9.3f ms/run %9.3f ms max %8.1f allocs/run\n", collectors[i].name, total_ms[i] / frames, max_ms[i],
+               (double)allocations[i] / frames);
+}
+
+/**
+ * Runs the whole suite, or with --replay FILE only benchReplay().
+ * The other options of the monitor apply, like --no-io-uring or --scan-threads.
+ * `--synthesize DIR PROCESSES INTERFACES CORES` only writes a synthetic tree
+ * into DIR, for the monitor's --proc-root and --sys-root.
+ */
+int main(int argc, char **argv)
+{
+    if (argc == 6 && strcmp(argv[1], "--synthesize") == 0)
+    {
+        if (!writeSyntheticTree(argv[2], atoi(argv[3]), atoi(argv[4]), atoi(argv[5])))
+        {
+            perror(argv[2]);
+            return 1;
+        }
+        printf("monitor --proc-root %s/proc --sys-root %s/sys\n", argv[2], argv[2]);
+        return 0;
+    }
+    // the benchmarks never record history, and must not take the lock of a running monitor
+    monitor_config.history = "none";
+    if (!parseArguments(argc, argv))
+        return 1;
+    if (monitor_config.replay)
+    {
+        benchReplay();
+        stopScanPool();
+        return 0;
+    }
+
+    const char *default_backend = scanFieldsBackend();
+    for (const char *backend : {"scalar", "sse2", "avx2"})
+    {
+        if (useScanFieldsBackend(backend))
+            benchParsers();
+    }
+    useScanFieldsBackend(default_backend);
+    benchSystem();
+    for (int extra : {0, 500, 2000})
+        runInChild([&] { benchProcesses(extra); });
+    for (int veth_pairs : {0, 50, 250})
+        benchLinksIn(veth_pairs);
+    runInChild([] { benchSyntheticTree(1000, 10, 8); });
+    runInChild([] { benchSyntheticTree(10000, 100, 64); });
+    runInChild([] { benchSyntheticTree(100000, 1000, 256); });
+    benchCollectors();
+    return 0;
+}
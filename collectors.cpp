@@ -0,0 +1,152 @@
+#include "header.h"
+
+// The collectors: each one reads a part of the kernel data into its own
+// fields of a Snapshot. The sampler thread runs them on their period, the
+// benchmark and the headless mode can run them anywhere else, and the views
+// only ever see their result.
+
+// previous /proc/stat values of the cpu collector
+static CPUStats prev_cpu_s;
+static vector<CPUStats> prev_cores;
+
+// previous byte counters of the network collector, summed over the interfaces
+static unsigned long long prev_rx_bytes, prev_tx_bytes;
+static long long prev_net_ns = 0;
+
+static const Metric static_metrics[] = {{"info", "os, cpu and kernel"}, {nullptr, nullptr}};
+static const Metric host_metrics[] = {{"info.hostname", ""}, {"info.user", ""}, {nullptr, nullptr}};
+static const Metric cpu_metrics[] = {
+    {"cpu_usage", "%", [](const Snapshot &state) { return state.cpu_usage; }}, {"core_usage", "% per core"}, {nullptr, nullptr}};
+static const Metric sensor_metrics[] = {{"cpu_temp", "C", [](const Snapshot &state) { return state.cpu_temp; }},
+                                        {"fan_speed", "RPM", [](const Snapshot &state) { return state.fan_speed; }},
+                                        {"fan_level", ""},
+                                        {nullptr, nullptr}};
+static const Metric monitor_metrics[] = {{"monitor_cpu", "% of one CPU"}, {"monitor_rss", "KiB"}, {nullptr, nullptr}};
+static const Metric memory_metrics[] = {{"mem", "KiB"},
+                                        {"mem.used_ram", "KiB", [](const Snapshot &state) { return (float)state.mem.used_ram; }},
+                                        {"mem.used_swap", "KiB", [](const Snapshot &state) { return (float)state.mem.used_swap; }},
+                                        {nullptr, nullptr}};
+static const Metric disk_metrics[] = {{"disk", "bytes"}, {nullptr, nullptr}};
+static const Metric process_metrics[] = {{"processes", "per process"},
+                                         {"process_count", "", [](const Snapshot &state) { return (float)state.process_count; }},
+                                         {"proc_events", "per second"},
+                                         {nullptr, nullptr}};
+static const Metric network_metrics[] = {{"nets", "bytes, packets"},
+                                         {"rx_rate", "bytes/s", [](const Snapshot &state) { return state.rx_rate; }},
+                                         {"tx_rate", "bytes/s", [](const Snapshot &state) { return state.tx_rate; }},
+                                         {nullptr, nullptr}};
+static const Metric address_metrics[] = {{"networks", "interfaces, addresses"}, {nullptr, nullptr}};
+
+const Collector collectors[COLLECTOR_COUNT] = {
+    {"static", 0, static_metrics, 0.5f,
+     [](Snapshot &state) { getSystemInfo(&state.info); },
+     [](const Snapshot &from, Snapshot &to) { to.info = from.info; }},
+    {"host", 5000, host_metrics, 0.05f,
+     [](Snapshot &state) { refreshHostInfo(&state.info); },
+     [](const Snapshot &from, Snapshot &to) {
+         to.info.hostname = from.info.hostname;
+         to.info.user = from.info.user;
+     }},
+    {"cpu", 250, cpu_metrics, 0.1f,
+     [](Snapshot &state) {
+         // the first run only gives the reference for the next one
+         if (prev_cores.empty())
+             getCPUStats(prev_cpu_s, prev_cores);
+         state.cpu_usage = getCPUUsage(prev_cpu_s, prev_cores, state.core_usage);
+     },
+     [](const Snapshot &from, Snapshot &to) {
+         to.cpu_usage = from.cpu_usage;
+         to.core_usage = from.core_usage;
+     }},
+    {"sensors", 1000, sensor_metrics, 0.1f,
+     [](Snapshot &state) {
+         state.cpu_temp = getCPUTemp();
+         state.fan_speed = atof(getSpeedFan().c_str());
+         state.fan_level = getFanLevel();
+     },
+     [](const Snapshot &from, Snapshot &to) {
+         to.cpu_temp = from.cpu_temp;
+         to.fan_speed = from.fan_speed;
+         to.fan_level = from.fan_level;
+     }},
+    {"monitor", 1000, monitor_metrics, 0.05f,
+     [](Snapshot &state) {
+         state.monitor_cpu = getMonitorCPUUsage();
+         state.monitor_rss = getMonitorRSS();
+     },
+     [](const Snapshot &from, Snapshot &to) {
+         to.monitor_cpu = from.monitor_cpu;
+         to.monitor_rss = from.monitor_rss;
+     }},
+    {"memory", 1000, memory_metrics, 0.1f,
+     [](Snapshot &state) { getMemoryValues(&state.mem); },
+     [](const Snapshot &from, Snapshot &to) { to.mem = from.mem; }},
+    {"disk", 10000, disk_metrics, 0.1f,
+     [](Snapshot &state) { getDiskValues(&state.disk); },
+     [](const Snapshot &from, Snapshot &to) { to.disk = from.disk; }},
+    {"processes", 1000, process_metrics, 5.0f,
+     [](Snapshot &state) {
+         getProcEvents(state.proc_events, state.processes);
+         updateProcessData(state.processes);
+         state.process_count = state.processes.size();
+     },
+     [](const Snapshot &from, Snapshot &to) {
+         to.process_count = from.process_count;
+         to.processes = from.processes;
+         to.proc_events = from.proc_events;
+     }},
+    {"network", 1000, network_metrics, 0.5f,
+     [](Snapshot &state) {
+         fillRXTXDatas(state.nets);
+         unsigned long long rx_bytes = 0, tx_bytes = 0;
+         for (const Net &net : state.nets)
+         {
+             rx_bytes += net.received.bytes;
+             tx_bytes += net.transmited.bytes;
+         }
+         // an interface going away makes the sums go down, that sample has no rate
+         long long now = monotonicNs();
+         bool valid = prev_net_ns != 0 && rx_bytes >= prev_rx_bytes && tx_bytes >= prev_tx_bytes;
+         state.rx_rate = valid ? (rx_bytes - prev_rx_bytes) * 1e9f / (now - prev_net_ns) : 0;
+         state.tx_rate = valid ? (tx_bytes - prev_tx_bytes) * 1e9f / (now - prev_net_ns) : 0;
+         prev_rx_bytes = rx_bytes;
+         prev_tx_bytes = tx_bytes;
+         prev_net_ns = now;
+     },
+     [](const Snapshot &from, Snapshot &to) {
+         to.nets = from.nets;
+         to.rx_rate = from.rx_rate;
+         to.tx_rate = from.tx_rate;
+     }},
+    {"addresses", 5000, address_metrics, 0.5f,
+     [](Snapshot &state) {
+         // rtnetlink notifications, or getifaddrs every period without them
+         if (!updateLinks(&state.networks))
+         {
+             state.networks.ip4s.clear();
+             getIpv4Network(&state.networks);
+         }
+     },
+     [](const Snapshot &from, Snapshot &to) { to.networks = from.networks; },
+     linkEventsFd},
+};
+
+/**
+ * Runs a collector once on the calling thread, measures it, and records the
+ * duration in the collector's probe.
+ *
+ * @param collector The collector to run.
+ * @param state Receives the fields of the collector, the storage of the previous run is reused.
+ * @param stats Its runs, last_duration_ms and syscalls are updated.
+ */
+void timeCollector(const Collector &collector, Snapshot &state, CollectorStats &stats)
+{
+    unsigned long long syscalls = syscall_count.load(memory_order_relaxed);
+    long long start = monotonicNs();
+    collector.sample(state);
+    long long end = monotonicNs();
+    stats.syscalls = syscall_count.load(memory_order_relaxed) - syscalls;
+    stats.runs++;
+    stats.last_duration_ms = (end - start) / 1e6f;
+    recordProbe(&collector - collectors, end - start);
+}
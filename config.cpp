@@ -0,0 +1,162 @@
+#include "header.h"
+
+// Options of the monitor, set once by parseArguments() before the sampler starts.
+MonitorConfig monitor_config = {
+    true, // io_uring
+    0,    // scan_threads
+    0.25, // max_cpu_fraction
+    false, // proc_events
+    30,   // max_fps
+    false, // headless
+    "-",  // output
+    false, // binary
+    0,    // samples
+    nullptr, // capture
+    nullptr, // replay
+    "/proc", // proc_root
+    "/sys",  // sys_root
+    24,      // history_hours
+    nullptr, // history
+};
+
+static void printUsage(const char *program)
+{
+    printf("Usage: %s [options]\n"
+           "  --no-io-uring     read the process stat files with synchronous syscalls\n"
+           "  --scan-threads N  read the process table with N threads (default: one per CPU, capped by --max-cpu)\n"
+           "  --max-cpu F       never use more than the fraction F of the CPUs for the process scan (default: 0.25)\n"
+           "  --proc-events     follow process creation and exit with the netlink proc connector (needs CAP_NET_ADMIN)\n"
+           "  --max-fps N       draw at most N frames per second (default: 30)\n"
+           "  --headless        no window, write every sample to the output instead\n"
+           "  --output FILE     headless output file (default: - for stdout)\n"
+           "  --binary          headless output in the binary format instead of text lines\n"
+           "  --samples N       headless: exit after N samples\n"
+           "  --capture FILE    record every /proc and /sys file read into FILE\n"
+           "  --replay FILE     read the files from a capture instead of the machine\n"
+           "  --proc-root DIR   read DIR in place of /proc, like a tree written by monitor_bench --synthesize\n"
+           "  --sys-root DIR    read DIR in place of /sys\n"
+           "  --history-hours N keep N hours of history for the plots (default: 24)\n"
+           "  --history FILE    keep the history in FILE across restarts, none for memory only\n"
+           "                    (default: $XDG_STATE_HOME/system-monitor.history)\n"
+           "  --help            show this help\n",
+           program);
+}
+
+/**
+ * Fills monitor_config from the command line.
+ *
+ * Sets the /proc and /sys roots, allocates the history store, and opens the
+ * capture or replay archive given.
+ *
+ * @return false if the monitor should exit, after --help, an unknown option or an archive that cannot be opened.
+ */
+bool parseArguments(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--no-io-uring") == 0)
+        {
+            monitor_config.io_uring = false;
+        }
+        else if (strcmp(argv[i], "--proc-events") == 0)
+        {
+            monitor_config.proc_events = true;
+        }
+        else if (strcmp(argv[i], "--scan-threads") == 0 && i + 1 < argc)
+        {
+            monitor_config.scan_threads = max(0, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--max-cpu") == 0 && i + 1 < argc)
+        {
+            float fraction = atof(argv[++i]);
+            if (fraction <= 0 || fraction > 1)
+            {
+                fprintf(stderr, "%s: --max-cpu must be in (0, 1]\n", argv[0]);
+                return false;
+            }
+            monitor_config.max_cpu_fraction = fraction;
+        }
+        else if (strcmp(argv[i], "--max-fps") == 0 && i + 1 < argc)
+        {
+            monitor_config.max_fps = max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--headless") == 0)
+        {
+            monitor_config.headless = true;
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            monitor_config.output = argv[++i];
+        }
+        else if (strcmp(argv[i], "--binary") == 0)
+        {
+            monitor_config.binary = true;
+        }
+        else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+        {
+            monitor_config.samples = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+        {
+            monitor_config.capture = argv[++i];
+        }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            monitor_config.replay = argv[++i];
+        }
+        else if (strcmp(argv[i], "--proc-root") == 0 && i + 1 < argc)
+        {
+            monitor_config.proc_root = argv[++i];
+        }
+        else if (strcmp(argv[i], "--sys-root") == 0 && i + 1 < argc)
+        {
+            monitor_config.sys_root = argv[++i];
+        }
+        else if (strcmp(argv[i], "--history-hours") == 0 && i + 1 < argc)
+        {
+            monitor_config.history_hours = max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--history") == 0 && i + 1 < argc)
+        {
+            monitor_config.history = argv[++i];
+        }
+        else if (strcmp(argv[i], "--help") == 0)
+        {
+            printUsage(argv[0]);
+            return false;
+        }
+        else
+        {
+            fprintf(stderr, "%s: unknown option %s\n", argv[0], argv[i]);
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    if (monitor_config.capture || monitor_config.replay)
+    {
+        // io_uring and the proc connector read the pid files outside of procfs.cpp
+        monitor_config.io_uring = false;
+        monitor_config.proc_events = false;
+    }
+    setFileRoots(monitor_config.proc_root, monitor_config.sys_root);
+    // replays and synthetic trees are not the history of this machine
+    if (monitor_config.replay || !liveFileRoots())
+        monitor_config.history = "none";
+    initHistory(monitor_config.history_hours, monitor_config.history);
+    if (!liveFileRoots())
+    {
+        // the proc connector reports the machine's processes, not the ones of the tree
+        monitor_config.proc_events = false;
+    }
+    if (monitor_config.capture && !startCapture(monitor_config.capture))
+    {
+        perror(monitor_config.capture);
+        return false;
+    }
+    if (monitor_config.replay && !startReplay(monitor_config.replay))
+    {
+        fprintf(stderr, "%s: %s is not a capture\n", argv[0], monitor_config.replay);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,178 @@
+#include "header.h"
+
+// Quantile sketches of the history store, after DDSketch (Masson et al.,
+// VLDB 2019). A value v > 0 falls in the bin of index ceil(log(v) / log(gamma))
+// with gamma = (1 + a) / (1 - a): every value of a bin is within a relative
+// error a of the value the bin stands for, so a quantile read from the bins
+// is too. Two sketches merge by adding the counts of their bins of same index,
+// which is what makes the sketch of any window the sum of those of its buckets.
+//
+// A QuantileSketch keeps SKETCH_BINS consecutive indexes from offset. When the
+// values of a bucket span more than that, the sketch collapses uniformly, as in
+// UDDSketch (Epicoco et al., 2020): bins 2i - 1 and 2i become bin i, which
+// squares gamma. Every quantile then keeps a bounded error, 2% for a bucket
+// spanning a factor of 140, 4% for 2e4, 8% for 4e8, instead of the low ones
+// being lost. A sketch merged with a more collapsed one is collapsed first.
+
+static const double SKETCH_ACCURACY = 0.02;
+static const double SKETCH_GAMMA = (1 + SKETCH_ACCURACY) / (1 - SKETCH_ACCURACY);
+static const double SKETCH_LOG_GAMMA = log(SKETCH_GAMMA);
+// Values below it are counted as 0.
+static const float SKETCH_MIN_VALUE = 1e-3f;
+// Index of SKETCH_MIN_VALUE before any collapse, the first bin of a SketchSum.
+static const int SKETCH_FIRST_INDEX = (int)ceil(log(SKETCH_MIN_VALUE) / SKETCH_LOG_GAMMA);
+
+// ceil(a / 2^collapses), the index of bin a once collapsed that many times.
+static int collapseIndex(int a, int collapses)
+{
+    int n = 1 << collapses;
+    return a >= 0 ? (a + n - 1) / n : -(-a / n);
+}
+
+// Index of the bin of a value of at least SKETCH_MIN_VALUE, before any collapse.
+static int sketchIndex(float value)
+{
+    int index = (int)ceil(log(value) / SKETCH_LOG_GAMMA);
+    return min(index, SKETCH_FIRST_INDEX + SKETCH_SUM_BINS - 1);
+}
+
+// The value a bin stands for, the one within the relative error of every value of the bin.
+static float sketchValue(int index, int collapses)
+{
+    double gamma = pow(SKETCH_GAMMA, 1 << collapses);
+    return 2 * pow(gamma, index) / (gamma + 1);
+}
+
+// Moves the bins so that bins[0] has the given index, every bin with values must stay in range.
+static void rebaseSketch(QuantileSketch &sketch, int offset)
+{
+    unsigned short bins[SKETCH_BINS] = {};
+    for (int i = 0; i < SKETCH_BINS; i++)
+        if (sketch.bins[i])
+            bins[sketch.offset + i - offset] = sketch.bins[i];
+    memcpy(sketch.bins, bins, sizeof(bins));
+    sketch.offset = offset;
+}
+
+// Merges the bins of a sketch two by two.
+static void collapseSketch(QuantileSketch &sketch)
+{
+    unsigned short bins[SKETCH_BINS] = {};
+    int offset = collapseIndex(sketch.offset, 1);
+    for (int i = 0; i < SKETCH_BINS; i++)
+    {
+        unsigned short &bin = bins[collapseIndex(sketch.offset + i, 1) - offset];
+        bin = min(bin + sketch.bins[i], USHRT_MAX);
+    }
+    memcpy(sketch.bins, bins, sizeof(bins));
+    sketch.offset = offset;
+    sketch.collapses++;
+}
+
+/**
+ * Empties a sketch.
+ */
+void clearSketch(QuantileSketch &sketch)
+{
+    memset(&sketch, 0, sizeof(sketch));
+}
+
+/**
+ * Adds a value to a sketch. Negative values are counted as 0, the counts
+ * stop at 65535 values per bin.
+ */
+void addToSketch(QuantileSketch &sketch, float value)
+{
+    if (!(value >= SKETCH_MIN_VALUE))
+    {
+        sketch.zero += sketch.zero < USHRT_MAX;
+        return;
+    }
+    int index = collapseIndex(sketchIndex(value), sketch.collapses);
+    int low = 0, high = SKETCH_BINS - 1; // bins with values
+    while (low < SKETCH_BINS && sketch.bins[low] == 0)
+        low++;
+    while (high >= 0 && sketch.bins[high] == 0)
+        high--;
+    if (low == SKETCH_BINS)
+        // empty: room on both sides of the first value
+        sketch.offset = index - SKETCH_BINS / 2;
+    else if (index < sketch.offset || index >= sketch.offset + SKETCH_BINS)
+    {
+        low = min(sketch.offset + low, index);
+        high = max(sketch.offset + high, index);
+        while (high - low >= SKETCH_BINS)
+        {
+            collapseSketch(sketch);
+            low = collapseIndex(low, 1);
+            high = collapseIndex(high, 1);
+            index = collapseIndex(index, 1);
+        }
+        // the room left split on both sides
+        rebaseSketch(sketch, low - (SKETCH_BINS - 1 - (high - low)) / 2);
+    }
+    unsigned short &bin = sketch.bins[index - sketch.offset];
+    bin += bin < USHRT_MAX;
+}
+
+/**
+ * Empties a sum of sketches.
+ */
+void clearSketchSum(SketchSum &sum)
+{
+    memset(&sum, 0, sizeof(sum));
+}
+
+/**
+ * Adds the counts of a sketch to a sum, collapsing the sum first when the
+ * sketch is more collapsed.
+ */
+void mergeSketch(SketchSum &sum, const QuantileSketch &sketch)
+{
+    for (; sum.collapses < sketch.collapses; sum.collapses++)
+    {
+        int first = collapseIndex(SKETCH_FIRST_INDEX, sum.collapses);
+        int next_first = collapseIndex(SKETCH_FIRST_INDEX, sum.collapses + 1);
+        for (int i = 0; i < SKETCH_SUM_BINS; i++)
+        {
+            unsigned count = sum.bins[i];
+            sum.bins[i] = 0;
+            sum.bins[collapseIndex(first + i, 1) - next_first] += count;
+        }
+    }
+    sum.zero += sketch.zero;
+    sum.count += sketch.zero;
+    int first = collapseIndex(SKETCH_FIRST_INDEX, sum.collapses);
+    for (int i = 0; i < SKETCH_BINS; i++)
+    {
+        if (sketch.bins[i] == 0)
+            continue;
+        int index = collapseIndex(sketch.offset + i, sum.collapses - sketch.collapses);
+        sum.bins[min(max(index - first, 0), SKETCH_SUM_BINS - 1)] += sketch.bins[i];
+        sum.count += sketch.bins[i];
+    }
+}
+
+/**
+ * Reads quantiles from a sum of sketches, in one pass over its bins.
+ *
+ * @param quantiles n quantiles between 0 and 1, in increasing order.
+ * @param out Receives the n values, 0 for an empty sum.
+ */
+void sketchQuantiles(const SketchSum &sum, const double *quantiles, int n, float *out)
+{
+    int first = collapseIndex(SKETCH_FIRST_INDEX, sum.collapses);
+    int q = 0;
+    unsigned long long seen = sum.zero;
+    // the value of rank quantile * (count - 1), counting from 0
+    for (; q < n && (sum.count == 0 || quantiles[q] * (sum.count - 1) < seen); q++)
+        out[q] = 0;
+    for (int i = 0; i < SKETCH_SUM_BINS && q < n; i++)
+    {
+        seen += sum.bins[i];
+        for (; q < n && quantiles[q] * (sum.count - 1) < seen; q++)
+            out[q] = sketchValue(first + i, sum.collapses);
+    }
+    for (; q < n; q++)
+        out[q] = sketchValue(first + SKETCH_SUM_BINS - 1, sum.collapses);
+}
@@ -0,0 +1,283 @@
+#include "header.h"
+
+// Capture and replay of the files read through procfs.cpp.
+//
+// A capture records, once per sampler iteration, every file whose content
+// changed since it was last recorded, and the pid listings of /proc. A replay
+// reads the capture back one frame per sampler iteration and serves the
+// recorded content instead of the machine's, so the collectors see the
+// captured host. Files that do not go through procfs.cpp (getifaddrs,
+// rtnetlink, statvfs, /proc/cpuinfo) and the monitor's own /proc/self files
+// still come from the machine.
+//
+// Archive, in host byte order:
+//   "SMCP", u32 version
+//   frames: u64 ns since the start of the capture, u32 entry count, entries
+//   entry:  u32 path id, i32 content length (-1 for a file that could not be read), content
+// An entry whose id has PATH_DECLARATION set gives the path of a new id as its content, it
+// comes before the first entry using that id. A pid listing is stored as the directory
+// path with a trailing '/', the pids as i32.
+
+static const char CAPTURE_MAGIC[4] = {'S', 'M', 'C', 'P'};
+static const unsigned CAPTURE_VERSION = 1;
+static const unsigned PATH_DECLARATION = 0x80000000u;
+
+struct FixtureEntry
+{
+    unsigned path_id;
+    bool missing;
+    string content;
+};
+
+// capture, the scan pool records from several threads
+static mutex capture_mutex;
+static FILE *capture_file = nullptr;
+static long long capture_start_ns;
+static long long capture_frame_ns = -1; // start of the frame being recorded, -1 before the first one
+static map<string, unsigned, less<>> capture_path_ids;
+static vector<string> capture_last; // last recorded content by path id, "\1" when missing
+static vector<FixtureEntry> capture_pending;
+
+// replay, only changed between two sampler iterations
+static FILE *replay_file = nullptr;
+static vector<string> replay_paths;
+static map<string, string, less<>> replay_files; // current content, a missing file has no entry
+static unsigned long long replay_frames = 0;
+static long long replay_time_ns = 0;
+
+// paths that are never captured nor replayed
+static bool ownFile(const char *path)
+{
+    return strncmp(path, "/proc/self/", 11) == 0 || strncmp(path, "/proc/thread-self/", 18) == 0;
+}
+
+/**
+ * Starts recording the files read through procfs.cpp into an archive.
+ *
+ * @param path The archive to create.
+ * @return false if it cannot be created.
+ */
+bool startCapture(const char *path)
+{
+    capture_file = fopen(path, "wb");
+    if (capture_file == nullptr)
+        return false;
+    fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC), 1, capture_file);
+    fwrite(&CAPTURE_VERSION, sizeof(CAPTURE_VERSION), 1, capture_file);
+    capture_start_ns = monotonicNs();
+    return true;
+}
+
+bool capturing()
+{
+    return capture_file != nullptr;
+}
+
+// Writes the entries recorded since the previous frame as one frame.
+static void writeCaptureFrame()
+{
+    unsigned long long time_ns = capture_frame_ns - capture_start_ns;
+    unsigned count = capture_pending.size();
+    fwrite(&time_ns, sizeof(time_ns), 1, capture_file);
+    fwrite(&count, sizeof(count), 1, capture_file);
+    for (const FixtureEntry &entry : capture_pending)
+    {
+        fwrite(&entry.path_id, sizeof(entry.path_id), 1, capture_file);
+        int len = entry.missing ? -1 : (int)entry.content.size();
+        fwrite(&len, sizeof(len), 1, capture_file);
+        fwrite(entry.content.data(), 1, entry.content.size(), capture_file);
+    }
+    capture_pending.clear();
+}
+
+/**
+ * Records the content of a file read through procfs.cpp, when it changed.
+ *
+ * @param path The absolute path of the file.
+ * @param buf Its content, nullptr if it could not be read.
+ * @param len The length of the content.
+ */
+void captureFile(const char *path, const char *buf, size_t len)
+{
+    if (ownFile(path))
+        return;
+    lock_guard<mutex> lock(capture_mutex);
+    auto it = capture_path_ids.find(string_view(path));
+    unsigned id;
+    if (it == capture_path_ids.end())
+    {
+        id = capture_last.size();
+        capture_path_ids.emplace(path, id);
+        capture_last.push_back("\1");
+        capture_pending.push_back({id | PATH_DECLARATION, false, path});
+    }
+    else
+        id = it->second;
+
+    string &last = capture_last[id];
+    if (buf == nullptr ? last == "\1" : (last.size() == len && memcmp(last.data(), buf, len) == 0))
+        return;
+    if (buf == nullptr)
+        last = "\1";
+    else
+        last.assign(buf, len);
+    capture_pending.push_back({id, buf == nullptr, buf == nullptr ? string() : last});
+}
+
+// Records a listing of the numeric entries of a directory.
+void captureDir(const char *path, const vector<int> &ids)
+{
+    string key = string(path) + "/";
+    captureFile(key.c_str(), (const char *)ids.data(), ids.size() * sizeof(int));
+}
+
+// Writes the last frame and closes the archive.
+void stopCapture()
+{
+    if (capture_file == nullptr)
+        return;
+    lock_guard<mutex> lock(capture_mutex);
+    if (capture_frame_ns >= 0)
+        writeCaptureFrame();
+    fclose(capture_file);
+    capture_file = nullptr;
+}
+
+/**
+ * Opens an archive written by a capture, the first frame is served after the
+ * first call to advanceFixtures().
+ *
+ * @return false if path is not a capture archive.
+ */
+bool startReplay(const char *path)
+{
+    replay_file = fopen(path, "rb");
+    if (replay_file == nullptr)
+        return false;
+    char magic[4];
+    unsigned version;
+    if (fread(magic, sizeof(magic), 1, replay_file) != 1 || memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0 ||
+        fread(&version, sizeof(version), 1, replay_file) != 1 || version != CAPTURE_VERSION)
+    {
+        fclose(replay_file);
+        replay_file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool replaying()
+{
+    return replay_file != nullptr;
+}
+
+// Reads the next frame of the replay and applies it to replay_files.
+static bool readReplayFrame()
+{
+    unsigned long long time_ns;
+    unsigned count;
+    if (fread(&time_ns, sizeof(time_ns), 1, replay_file) != 1 || fread(&count, sizeof(count), 1, replay_file) != 1)
+        return false;
+    string content;
+    for (unsigned i = 0; i < count; i++)
+    {
+        unsigned id;
+        int len;
+        if (fread(&id, sizeof(id), 1, replay_file) != 1 || fread(&len, sizeof(len), 1, replay_file) != 1)
+            return false;
+        content.resize(max(len, 0));
+        if (len > 0 && fread(&content[0], len, 1, replay_file) != 1)
+            return false;
+        if (id & PATH_DECLARATION)
+        {
+            replay_paths.push_back(content);
+            continue;
+        }
+        if (id >= replay_paths.size())
+            return false;
+        if (len < 0)
+            replay_files.erase(replay_paths[id]);
+        else
+            replay_files[replay_paths[id]] = content;
+    }
+    replay_time_ns = time_ns;
+    replay_frames++;
+    return true;
+}
+
+/**
+ * Moves the capture or the replay to the next frame, called by the sampler
+ * before the collectors of an iteration run.
+ *
+ * @return false when a replay has no frame left, it then keeps serving the last one.
+ */
+bool advanceFixtures()
+{
+    if (capture_file != nullptr)
+    {
+        lock_guard<mutex> lock(capture_mutex);
+        if (capture_frame_ns >= 0)
+            writeCaptureFrame();
+        capture_frame_ns = monotonicNs();
+    }
+    if (replay_file != nullptr)
+        return readReplayFrame();
+    return true;
+}
+
+// Number of frames replayed so far, and the capture time of the current one in seconds.
+unsigned long long replayPosition(double &seconds)
+{
+    seconds = replay_time_ns / 1e9;
+    return replay_frames;
+}
+
+/**
+ * Looks a file up in the replay.
+ *
+ * @param path The absolute path of the file.
+ * @param content Receives the recorded content, nullptr when the file did not exist or could not be read.
+ * @return false if the file is not replayed and must be read from the machine.
+ */
+bool replayFile(const char *path, const string *&content)
+{
+    if (replay_file == nullptr || ownFile(path))
+        return false;
+    auto it = replay_files.find(string_view(path));
+    content = it == replay_files.end() ? nullptr : &it->second;
+    return true;
+}
+
+// Looks a directory listing up in the replay, see replayFile().
+bool replayDir(const char *path, vector<int> &ids)
+{
+    char key[PATH_MAX + 1];
+    snprintf(key, sizeof(key), "%s/", path);
+    const string *content;
+    if (!replayFile(key, content))
+        return false;
+    ids.clear();
+    if (content != nullptr)
+        ids.assign((const int *)content->data(), (const int *)(content->data() + content->size()));
+    return true;
+}
+
+/**
+ * Gives the /proc or /sys path of a directory descriptor, for the files read relative to it.
+ * The descriptors used by the collectors stay open, so the result is kept.
+ */
+const char *fixtureDirPath(int dir_fd)
+{
+    static mutex paths_mutex;
+    static map<int, string> paths;
+    lock_guard<mutex> lock(paths_mutex);
+    auto it = paths.find(dir_fd);
+    if (it != paths.end())
+        return it->second.c_str();
+    char link[32];
+    char target[PATH_MAX];
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", dir_fd);
+    ssize_t n = readlink(link, target, sizeof(target) - 1);
+    target[max(n, (ssize_t)0)] = '\0';
+    return paths.emplace(dir_fd, unrootedPath(target)).first->second.c_str();
+}
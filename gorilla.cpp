@@ -0,0 +1,218 @@
+#include "header.h"
+
+// Compression of the closed blocks of the history store, after the Gorilla
+// paper (Pelkonen et al., VLDB 2015), on 32-bit floats. The points of a block
+// are written in bucket order, the empty buckets are skipped:
+//   bucket: delta-of-delta of the bucket index, '0' for the same step as the
+//           previous point, '10' + 4 bits, '110' + 7 bits, '1110' + 11 bits
+//   count:  '0' when equal to the previous count, '1' + 32 bits
+//   min, then max and sum when count > 1 (they equal min otherwise):
+//           XOR with the previous value of the same field, '0' for equal,
+//           '10' + the meaningful bits when they fit in the previous window,
+//           '11' + 5 bits of leading zeros + 5 bits of length - 1 + the bits
+// A series sampled every second at a steady value takes about 4 bits a point.
+
+struct BitWriter
+{
+    unsigned char *buf;
+    size_t capacity; // in bytes
+    size_t bit;
+};
+
+struct BitReader
+{
+    const unsigned char *buf;
+    size_t size; // in bytes
+    size_t bit;
+};
+
+// Writes the n low bits of value, most significant first, a byte at a time.
+// Returns false when the buffer is full.
+static bool writeBits(BitWriter &w, unsigned long long value, int n)
+{
+    if (w.bit + n > w.capacity * 8)
+        return false;
+    while (n > 0)
+    {
+        int offset = w.bit & 7;
+        int take = min(8 - offset, n);
+        unsigned bits = (value >> (n - take)) & ((1u << take) - 1);
+        unsigned char &byte = w.buf[w.bit >> 3];
+        // the first write to a byte clears what the slot held before
+        byte = (offset == 0 ? 0 : byte) | bits << (8 - offset - take);
+        w.bit += take;
+        n -= take;
+    }
+    return true;
+}
+
+// Reads n bits written by writeBits(), 0 bits past the end.
+static unsigned long long readBits(BitReader &r, int n)
+{
+    unsigned long long value = 0;
+    while (n > 0)
+    {
+        size_t index = r.bit >> 3;
+        int offset = r.bit & 7;
+        int take = min(8 - offset, n);
+        unsigned byte = index < r.size ? r.buf[index] : 0;
+        value = value << take | ((byte >> (8 - offset - take)) & ((1u << take) - 1));
+        r.bit += take;
+        n -= take;
+    }
+    return value;
+}
+
+// Previous value and meaningful bits window of one XOR-encoded field.
+struct XorState
+{
+    unsigned prev;
+    int lead; // -1 before the first window
+    int trail;
+};
+
+static unsigned floatBits(float value)
+{
+    unsigned bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bitsFloat(unsigned bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static bool writeXor(BitWriter &w, XorState &state, unsigned bits)
+{
+    unsigned x = bits ^ state.prev;
+    state.prev = bits;
+    if (x == 0)
+        return writeBits(w, 0, 1);
+    int lead = min(__builtin_clz(x), 31);
+    int trail = __builtin_ctz(x);
+    if (state.lead >= 0 && lead >= state.lead && trail >= state.trail)
+        return writeBits(w, 2, 2) && writeBits(w, x >> state.trail, 32 - state.lead - state.trail);
+    state.lead = lead;
+    state.trail = trail;
+    int len = 32 - lead - trail;
+    return writeBits(w, 3, 2) && writeBits(w, lead, 5) && writeBits(w, len - 1, 5) && writeBits(w, x >> trail, len);
+}
+
+static unsigned readXor(BitReader &r, XorState &state)
+{
+    if (readBits(r, 1) == 0)
+        return state.prev;
+    if (readBits(r, 1) == 1)
+    {
+        state.lead = readBits(r, 5);
+        int len = readBits(r, 5) + 1;
+        state.trail = 32 - state.lead - len;
+    }
+    int len = 32 - state.lead - state.trail;
+    state.prev ^= (unsigned)readBits(r, len) << state.trail;
+    return state.prev;
+}
+
+static bool writeDelta(BitWriter &w, int dod)
+{
+    if (dod == 0)
+        return writeBits(w, 0, 1);
+    if (dod >= -7 && dod <= 8)
+        return writeBits(w, 2, 2) && writeBits(w, dod + 7, 4);
+    if (dod >= -63 && dod <= 64)
+        return writeBits(w, 6, 3) && writeBits(w, dod + 63, 7);
+    return writeBits(w, 14, 4) && writeBits(w, dod + 1023, 11);
+}
+
+static int readDelta(BitReader &r)
+{
+    if (readBits(r, 1) == 0)
+        return 0;
+    if (readBits(r, 1) == 0)
+        return (int)readBits(r, 4) - 7;
+    if (readBits(r, 1) == 0)
+        return (int)readBits(r, 7) - 63;
+    readBits(r, 1);
+    return (int)readBits(r, 11) - 1023;
+}
+
+/**
+ * Compresses a block of the history store.
+ *
+ * @param points The HISTORY_BLOCK_POINTS buckets of the block, count 0 for the empty ones.
+ * @param out Receives the compressed block.
+ * @param capacity The size of out.
+ * @param count Receives the number of non-empty buckets.
+ * @param bytes Receives the compressed size.
+ * @return false if the block does not fit in capacity.
+ */
+bool compressHistoryBlock(const HistoryPoint *points, unsigned char *out, size_t capacity, unsigned &count, size_t &bytes)
+{
+    BitWriter w = {out, capacity, 0};
+    XorState min_state = {0, -1, 0}, max_state = {0, -1, 0}, sum_state = {0, -1, 0};
+    int prev_index = -1, prev_delta = 1;
+    unsigned prev_count = 1;
+    count = 0;
+    for (int i = 0; i < HISTORY_BLOCK_POINTS; i++)
+    {
+        const HistoryPoint &p = points[i];
+        if (p.count == 0)
+            continue;
+        int delta = i - prev_index;
+        bool ok = writeDelta(w, delta - prev_delta);
+        prev_index = i;
+        prev_delta = delta;
+        ok = ok && (p.count == prev_count ? writeBits(w, 0, 1) : writeBits(w, 1, 1) && writeBits(w, p.count, 32));
+        prev_count = p.count;
+        ok = ok && writeXor(w, min_state, floatBits(p.min));
+        if (p.count > 1)
+            ok = ok && writeXor(w, max_state, floatBits(p.max)) && writeXor(w, sum_state, floatBits(p.sum));
+        if (!ok)
+            return false;
+        count++;
+    }
+    bytes = (w.bit + 7) / 8;
+    return true;
+}
+
+/**
+ * Restores a block written by compressHistoryBlock().
+ *
+ * @param in The compressed block.
+ * @param size Its size in bytes.
+ * @param count The number of non-empty buckets it holds.
+ * @param points Receives the HISTORY_BLOCK_POINTS buckets of the block.
+ */
+void decompressHistoryBlock(const unsigned char *in, size_t size, unsigned count, HistoryPoint *points)
+{
+    BitReader r = {in, size, 0};
+    XorState min_state = {0, -1, 0}, max_state = {0, -1, 0}, sum_state = {0, -1, 0};
+    int index = -1, delta = 1;
+    unsigned point_count = 1;
+    fill(points, points + HISTORY_BLOCK_POINTS, HistoryPoint());
+    for (unsigned n = 0; n < count; n++)
+    {
+        delta += readDelta(r);
+        index += delta;
+        if (readBits(r, 1))
+            point_count = readBits(r, 32);
+        if (index < 0 || index >= HISTORY_BLOCK_POINTS)
+            return;
+        HistoryPoint &p = points[index];
+        p.count = point_count;
+        p.min = bitsFloat(readXor(r, min_state));
+        if (point_count > 1)
+        {
+            p.max = bitsFloat(readXor(r, max_state));
+            p.sum = bitsFloat(readXor(r, sum_state));
+        }
+        else
+        {
+            p.max = p.min;
+            p.sum = p.min;
+        }
+    }
+}
@@ -24,6 +24,11 @@
 #include <sys/types.h>
 #include <sys/sysinfo.h>
 #include <sys/statvfs.h>
+#include <sys/utsname.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <utmp.h>
+#include <set>
 // for time and date
 #include <ctime>
 // ifconfig ip addresses
@@ -31,9 +36,14 @@
 #include <ifaddrs.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <net/if.h>
 #include <map>
 #include <filesystem>
 #include <algorithm>
+// sampler thread and snapshot hand-off
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 using namespace std;
 struct CPUStats
@@ -54,7 +64,7 @@ struct CPUStats
 struct Proc
 {
     int pid;
-    string name;
+    char name[64];
     char state;
     long unsigned vsize;
     double rss; 
@@ -69,38 +79,67 @@ struct Proc
 
 struct IP4
 {
-    char *name;
+    char name[IFNAMSIZ];
     char addressBuffer[INET_ADDRSTRLEN];
 };
 
+// An IPv4 or IPv6 address of an interface.
+struct LinkAddress
+{
+    int family; // AF_INET or AF_INET6
+    char address[INET6_ADDRSTRLEN];
+    unsigned char prefix;
+};
+
+// A network interface, kept up to date from rtnetlink notifications.
+struct Link
+{
+    int index;
+    char name[IFNAMSIZ];
+    bool up;      // administratively up (IFF_UP)
+    bool carrier; // lower layer up (IFF_LOWER_UP)
+    vector<LinkAddress> addresses;
+};
+
+// A change of an interface or of its addresses, stamped with the time the kernel queued it.
+struct LinkEvent
+{
+    struct timespec time; // CLOCK_REALTIME
+    char text[96];
+};
+
 struct Networks
 {
     vector<IP4> ip4s;
-    
+    vector<Link> links;       // empty when rtnetlink is not available
+    vector<LinkEvent> events; // oldest first
+    unsigned dump_generation; // the one of the last dump of links, see updateLinks(), 0 for none
 };
 
+// transmit counters of an interface, in the order of /proc/net/dev
 struct TX
 {
-    int bytes;
-    int packets;
-    int errs;
-    int drop;
-    int fifo;
-    int frame;
-    int compressed;
-    int multicast;
+    unsigned long long bytes;
+    unsigned long long packets;
+    unsigned long long errs;
+    unsigned long long drop;
+    unsigned long long fifo;
+    unsigned long long colls;
+    unsigned long long carrier;
+    unsigned long long compressed;
 };
 
+// receive counters of an interface, in the order of /proc/net/dev
 struct RX
 {
-    int bytes;
-    int packets;
-    int errs;
-    int drop;
-    int fifo;
-    int colls;
-    int carrier;
-    int compressed;
+    unsigned long long bytes;
+    unsigned long long packets;
+    unsigned long long errs;
+    unsigned long long drop;
+    unsigned long long fifo;
+    unsigned long long frame;
+    unsigned long long compressed;
+    unsigned long long multicast;
 };
 
 struct Memory
@@ -113,39 +152,394 @@ struct Memory
 
 struct Net
 {
+    char name[IFNAMSIZ];
     RX received;
     TX transmited;
 };
 
+struct Disk
+{
+    unsigned long total;
+    unsigned long used;
+};
+
+// A /proc or /sys file kept open between samples, see readProcFile().
+struct ProcFile
+{
+    const char *path;
+    int fd;
+    long long failed_at; // monotonic time of the last failed open, 0 if none
+    unsigned generation; // roots the descriptor was opened under, see setFileRoots()
+    vector<char> buf;
+    size_t len;
+};
+
+// Facts about the machine that are read once at startup.
+// Only hostname and user can change while the monitor runs, see refreshHostInfo().
+struct SystemInfo
+{
+    const char *os;
+    string cpu_brand;
+    int cores;
+    int threads;
+    string kernel_release;
+    string hostname;
+    string user;
+    time_t utmp_mtime;
+};
+
+// Scheduling statistics of one collector, copied into every snapshot.
+// Jitter is how late a run started compared to its deadline.
+struct CollectorStats
+{
+    const char *name;
+    int period_ms; // 0 means the collector only runs once
+    float cost_ms; // expected duration of one run, see Collector
+    unsigned long long runs;
+    unsigned long long syscalls; // during the last run
+    float last_duration_ms;
+    float jitter_last_ms;
+    float jitter_avg_ms;
+    float jitter_max_ms;
+};
+
+// Options given on the command line, see parseArguments().
+struct MonitorConfig
+{
+    bool io_uring; // batch the per-process reads with io_uring when the kernel supports it
+    int scan_threads; // threads reading the process table, 0 means one per CPU
+    float max_cpu_fraction; // at most this fraction of the CPUs is used by the process scan
+    bool proc_events; // follow fork/exec/exit with the proc connector instead of listing /proc
+    int max_fps; // upper bound of the frame rate, frames are only drawn on input or new data
+    bool headless; // write samples to output instead of opening a window
+    const char *output; // headless output file, "-" for stdout
+    bool binary;        // headless output in the binary format instead of text lines
+    unsigned long long samples; // headless: stop after this many samples, 0 means never
+    const char *capture; // archive recording the files read, see fixtures.cpp, nullptr for none
+    const char *replay;  // archive served instead of the machine's files, nullptr for none
+    const char *proc_root; // read in place of /proc, see setFileRoots()
+    const char *sys_root;  // read in place of /sys
+    int history_hours; // retention of the history store, at every resolution
+    const char *history; // file of the history store, nullptr for the default one, "none" for memory only
+};
+
+struct Uring;
+
+// State reused from one process scan to the next, see readPidStats().
+struct PidScanner
+{
+    int proc_fd;         // /proc, the stat files are opened relative to it
+    bool uring;          // ring is set up and used for the reads
+    bool warm;           // a whole scan was read, see scanPids()
+    Uring *ring;
+    vector<char> buffers; // one read buffer per pid of a batch
+};
+
+// A process seen exiting by the proc connector.
+struct ExitedProc
+{
+    int pid;
+    char name[64]; // empty if the process was never seen alive
+    double cpu_seconds; // user + system time at exit, -1 if unknown
+    int exit_code; // wait status, as returned by waitpid()
+    time_t time;
+};
+
+// Process events, only active when the proc connector could be used.
+struct ProcEvents
+{
+    bool active;
+    unsigned long long forks;
+    unsigned long long execs;
+    unsigned long long exits;
+    float fork_rate; // per second, since the previous sample
+    float exec_rate;
+    float exit_rate;
+    vector<ExitedProc> exited; // newest first
+};
+
+const int COLLECTOR_COUNT = 10;
+
+// Overhead probes, see probes.cpp. The collectors are probes 0 to COLLECTOR_COUNT - 1.
+enum ProbeId
+{
+    PROBE_PUBLISH = COLLECTOR_COUNT,
+    PROBE_SYSTEM_WINDOW,
+    PROBE_MEMORY_WINDOW,
+    PROBE_NETWORK_WINDOW,
+    PROBE_FRAME,
+    PROBE_SAMPLE_SYSCALLS,
+    PROBE_SAMPLE_ALLOCATIONS,
+    PROBE_FRAME_ALLOCATIONS,
+    PROBE_COUNT
+};
+
+struct ProbeSummary
+{
+    unsigned long long count;
+    unsigned long long p50;
+    unsigned long long p99;
+    unsigned long long max;
+};
+
+// Everything the UI shows, collected by the sampler thread.
+// A published snapshot is never modified while the UI holds it, windows only read it.
+// seq grows by one per publication, 0 means nothing was published yet.
+struct Snapshot
+{
+    unsigned long long seq;
+    SystemInfo info;
+    int process_count;
+    float cpu_usage;
+    vector<float> core_usage;
+    float monitor_cpu; // CPU used by the monitor itself, in percent of one CPU
+    long long monitor_rss; // resident memory of the monitor, in KiB
+    float cpu_temp;
+    float fan_speed;
+    string fan_level;
+    Memory mem;
+    Disk disk;
+    vector<Proc> processes; // sorted by pid
+    ProcEvents proc_events;
+    vector<Net> nets;
+    float rx_rate; // bytes per second received by all the interfaces since the previous sample
+    float tx_rate;
+    Networks networks;
+    CollectorStats collectors[COLLECTOR_COUNT];
+};
+
+// One value a collector writes into the snapshots.
+struct Metric
+{
+    const char *name; // the Snapshot field
+    const char *unit;
+    // optional, the value kept in the history store each time the collector runs, see history.cpp
+    float (*history)(const Snapshot &state);
+};
+
+// Resolutions of the history store: 1 s, 10 s, 1 min and 10 min.
+const int HISTORY_LEVELS = 4;
+// Buckets of a block of the history store, the unit of compression.
+const int HISTORY_BLOCK_POINTS = 1024;
+
+// One bucket of a series of the history store.
+struct HistoryPoint
+{
+    float min;
+    float max;
+    float sum;
+    unsigned count; // values added to the bucket, 0 for a gap
+};
+
+// Bins of a QuantileSketch, 256 bytes with its other fields.
+const int SKETCH_BINS = 124;
+// Bins of a SketchSum, the values from 0.001 to about 6e14 before any collapse.
+const int SKETCH_SUM_BINS = 1024;
+
+// The DDSketch of the values of a rollup bucket of the history store, see ddsketch.cpp.
+struct QuantileSketch
+{
+    int offset;                // index of bins[0]
+    unsigned short zero;       // values too small for a bin
+    unsigned short collapses;  // times the bins were merged two by two
+    unsigned short bins[SKETCH_BINS];
+};
+
+// The sketches of a window merged, every index in its own bin.
+struct SketchSum
+{
+    unsigned long long count;
+    unsigned long long zero;
+    int collapses;
+    unsigned bins[SKETCH_SUM_BINS]; // from the index of 0.001
+};
+
+// A source of snapshot data, see collectors.cpp. sample() reads the kernel and
+// writes the collector's own fields of a Snapshot, reusing their storage, and
+// never draws anything. It may run on any thread, but never on two at once.
+struct Collector
+{
+    const char *name;
+    int period_ms; // 0 means the collector only runs once
+    const Metric *metrics; // the fields written by sample(), ended by a null name
+    float cost_ms; // expected duration of one run on a desktop, longer runs are highlighted in the sampler window
+    void (*sample)(Snapshot &state);
+    // copies the fields owned by the collector, used to bring a recycled buffer up to date
+    void (*copy)(const Snapshot &from, Snapshot &to);
+    // optional, a descriptor that runs the collector early when it becomes readable
+    int (*event_fd)();
+};
+
 // student TODO : system stats
 
 string CPUinfo();
 const char *getOsName();
-int getProcesses();
-void getCPUStats(CPUStats &cpu_s);
-float getCPUUsage(CPUStats &prev_cpu_s);
+void getSystemInfo(SystemInfo *info);
+void refreshHostInfo(SystemInfo *info);
+void getCPUStats(CPUStats &cpu_s, vector<CPUStats> &cores);
+float getCPUUsage(CPUStats &prev_cpu_s, vector<CPUStats> &prev_cores, vector<float> &core_usage);
 string getSpeedFan();
 string getFanLevel();
 float getCPUTemp();
-void drawTabbedContainer();
-void getCPUTabbed();
-void getFanTabbed();
-void getThermalTabbed();
+float getMonitorCPUUsage();
 
 // student TODO : memory and processes
 
-void getMemory();
 void getMemoryValues(Memory *mem);
-void getDiskUsage();
-void getProcessTable();
-void updateProcessData();
+void getDiskValues(Disk *disk);
+void computeProcUsage(Proc &proc, double uptime);
+void updateProcessData(vector<Proc> &processes);
 
 // student TODO : network
 
 void getIpv4Network(Networks *networks);
-void getNetworkTable(Networks *networks);
-void drawNetworkTabbed();
+void fillRXTXDatas(vector<Net> &nets);
+bool readNetDev(vector<Net> &nets);
+
+// views
+
+void drawTabbedContainer(const Snapshot &snap);
+void drawCPUTab(const Snapshot &snap);
+void drawFanTab(const Snapshot &snap);
+void drawThermalTab(const Snapshot &snap);
+void drawSamplerStats(const Snapshot &snap);
+void drawOverhead(const Snapshot &snap, float frames_per_second);
+void drawMemory(const Snapshot &snap);
+void drawDiskUsage(const Snapshot &snap);
+void drawProcessTable(const Snapshot &snap);
+void drawProcessEvents(const Snapshot &snap);
+void drawIpv4Network(const Networks &networks);
+void drawLinks(const Networks &networks);
+void drawNetworkTable(const Snapshot &snap);
+void drawNetworkTabbed(const Snapshot &snap);
+
+// collectors
+
+extern const Collector collectors[COLLECTOR_COUNT];
+void timeCollector(const Collector &collector, Snapshot &state, CollectorStats &stats);
+
+// history
+
+void initHistory(int hours, const char *path);
+void recordHistory(int collector, const Snapshot &state);
+int findSeries(const char *name);
+int historySeriesCount();
+const char *historySeriesName(int series);
+int historyResolution(int level);
+int readHistoryColumns(int series, double start, double span, int columns, vector<HistoryPoint> &out);
+void historyCompression(int series, size_t &points, size_t &bytes);
+size_t historyBytes();
+bool compressHistoryBlock(const HistoryPoint *points, unsigned char *out, size_t capacity, unsigned &count, size_t &bytes);
+void decompressHistoryBlock(const unsigned char *in, size_t size, unsigned count, HistoryPoint *points);
+unsigned long long historyQuantiles(int series, double start, double span, const double *quantiles, int n, float *out);
+void clearSketch(QuantileSketch &sketch);
+void addToSketch(QuantileSketch &sketch, float value);
+void clearSketchSum(SketchSum &sum);
+void mergeSketch(SketchSum &sum, const QuantileSketch &sketch);
+void sketchQuantiles(const SketchSum &sum, const double *quantiles, int n, float *out);
+
+// probes
+
+void recordProbe(int probe, unsigned long long value);
+const char *probeName(int probe);
+bool probeIsTiming(int probe);
+ProbeSummary summarizeProbe(int probe);
+unsigned long long allocationCount();
+unsigned long long threadAllocationCount();
+long long getMonitorRSS();
+
+// config
+
+extern MonitorConfig monitor_config;
+bool parseArguments(int argc, char **argv);
+
+// headless
+
+int runHeadless();
+
+// procfs
+
+extern atomic<unsigned long long> syscall_count;
+void countSyscalls(unsigned long long n);
+bool readProcFile(ProcFile &file);
+ssize_t readSmallFile(const char *path, char *buf, size_t size);
+ssize_t readSmallFileAt(int dir_fd, const char *path, char *buf, size_t size);
+int openProcDir();
+int procDirFd();
+void setFileRoots(const char *proc_root, const char *sys_root);
+bool liveFileRoots();
+const char *rootedPath(const char *path, char *out, size_t size);
+string unrootedPath(const char *path);
+size_t listPids(int dir_fd, vector<int> &ids);
+
+// capture and replay
+
+bool startCapture(const char *path);
+bool capturing();
+void captureFile(const char *path, const char *buf, size_t len);
+void captureDir(const char *path, const vector<int> &ids);
+void stopCapture();
+bool startReplay(const char *path);
+bool replaying();
+bool advanceFixtures();
+unsigned long long replayPosition(double &seconds);
+bool replayFile(const char *path, const string *&content);
+bool replayDir(const char *path, vector<int> &ids);
+const char *fixtureDirPath(int dir_fd);
+
+// synthetic trees, only in the benchmark binary
+
+string syntheticStat(int cores);
+string syntheticNetDev(int interfaces);
+bool writeSyntheticTree(const char *root, int processes, int interfaces, int cores);
+void removeTree(const char *root);
+
+// process scan
+
+PidScanner *createPidScanner(bool use_io_uring);
+void destroyPidScanner(PidScanner *scanner);
+void readPidStats(PidScanner &scanner, const int *pids, size_t count, double uptime, vector<Proc> &out);
+void scanPids(const vector<int> &pids, double uptime, vector<Proc> &processes);
+int scanPoolSize();
+void stopScanPool();
+
+// rtnetlink
+
+bool getLinkStats(vector<Net> &nets);
+int linkEventsFd();
+bool updateLinks(Networks *networks);
+
+// process events
+
+bool startProcEvents();
+void stopProcEvents();
+bool getProcEventPids(vector<int> &pids);
+void forgetProcEventPids(const vector<int> &pids);
+void getProcEvents(ProcEvents &events, const vector<Proc> &processes);
+
+// parsers
+
+const char *skipSpaces(const char *p, const char *end);
+const char *nextLine(const char *p, const char *end);
+const char *scanU64(const char *p, const char *end, unsigned long long &out);
+const char *scanI64(const char *p, const char *end, long long &out);
+const char *scanDouble(const char *p, const char *end, double &out);
+size_t scanFields(const char *&p, const char *end, unsigned long long *out, size_t max);
+const char *scanFieldsBackend();
+bool useScanFieldsBackend(const char *name);
+bool parseCPUStat(const char *buf, size_t len, CPUStats &cpu_s, vector<CPUStats> &cores);
+bool parseMeminfo(const char *buf, size_t len, Memory &mem);
+size_t parseNetDev(const char *buf, size_t len, vector<Net> &nets);
+bool parseUptime(const char *buf, size_t len, double &uptime);
+bool parsePidStat(const char *buf, size_t len, Proc &proc);
+
+// sampler
 
-extern const int REFRESH_INTERVAL;
+long long monotonicNs();
+void startSampler();
+void stopSampler();
+void setSnapshotListener(void (*listener)());
+const Snapshot &acquireSnapshot();
+const Snapshot &getSnapshot();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "header.h"
+#include <poll.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+
+// Headless mode: the sampler runs as usual, but every published snapshot is
+// written to stdout or a file instead of being drawn. Nothing here touches
+// SDL, OpenGL or ImGui, so it runs on machines without a display.
+
+// Magic and version at the start of a binary output.
+static const char HEADLESS_MAGIC[4] = {'S', 'M', 'O', 'N'};
+static const unsigned HEADLESS_VERSION = 1;
+
+static int headless_wake_fd = -1; // eventfd written by the sampler on every publication
+
+static void wakeHeadless()
+{
+    uint64_t one = 1;
+    if (write(headless_wake_fd, &one, sizeof(one)) < 0)
+        return;
+}
+
+static double realtimeSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Writes a snapshot as one line of space separated key=value fields.
+ * Cores are listed as core=a,b,c and interfaces as net=name:rx:tx,name:rx:tx.
+ */
+static void writeTextSample(FILE *out, const Snapshot &snap)
+{
+    fprintf(out, "t=%.3f cpu=%.2f core=", realtimeSeconds(), snap.cpu_usage);
+    for (size_t i = 0; i < snap.core_usage.size(); i++)
+        fprintf(out, i ? ",%.1f" : "%.1f", snap.core_usage[i]);
+    fprintf(out, " temp=%.1f fan=%.0f ram=%lld/%lld swap=%lld/%lld disk=%lu/%lu procs=%d self=%.2f net=",
+            snap.cpu_temp, snap.fan_speed, snap.mem.used_ram, snap.mem.total_ram, snap.mem.used_swap, snap.mem.total_swap,
+            snap.disk.used, snap.disk.total, snap.process_count, snap.monitor_cpu);
+    for (size_t i = 0; i < snap.nets.size(); i++)
+    {
+        const Net &net = snap.nets[i];
+        fprintf(out, i ? ",%s:%llu:%llu" : "%s:%llu:%llu", net.name, net.received.bytes, net.transmited.bytes);
+    }
+    fputc('\n', out);
+}
+
+// Binary record, in host byte order, followed by the core usages and the interfaces.
+struct HeadlessRecord
+{
+    unsigned size; // of the whole record, this header included
+    unsigned process_count;
+    double time; // seconds since the epoch
+    float cpu_usage;
+    float cpu_temp;
+    float fan_speed;
+    float monitor_cpu;
+    long long used_ram;
+    long long total_ram;
+    long long used_swap;
+    long long total_swap;
+    unsigned long long disk_used;
+    unsigned long long disk_total;
+    unsigned short core_count;
+    unsigned short net_count;
+    unsigned pad;
+};
+
+struct HeadlessNet
+{
+    char name[IFNAMSIZ];
+    unsigned long long rx_bytes;
+    unsigned long long tx_bytes;
+};
+
+/**
+ * Writes a snapshot as a HeadlessRecord, core_count floats, then net_count HeadlessNet.
+ */
+static void writeBinarySample(FILE *out, const Snapshot &snap)
+{
+    HeadlessRecord record;
+    memset(&record, 0, sizeof(record));
+    record.size = sizeof(record) + snap.core_usage.size() * sizeof(float) + snap.nets.size() * sizeof(HeadlessNet);
+    record.process_count = snap.process_count;
+    record.time = realtimeSeconds();
+    record.cpu_usage = snap.cpu_usage;
+    record.cpu_temp = snap.cpu_temp;
+    record.fan_speed = snap.fan_speed;
+    record.monitor_cpu = snap.monitor_cpu;
+    record.used_ram = snap.mem.used_ram;
+    record.total_ram = snap.mem.total_ram;
+    record.used_swap = snap.mem.used_swap;
+    record.total_swap = snap.mem.total_swap;
+    record.disk_used = snap.disk.used;
+    record.disk_total = snap.disk.total;
+    record.core_count = snap.core_usage.size();
+    record.net_count = snap.nets.size();
+    fwrite(&record, sizeof(record), 1, out);
+    fwrite(snap.core_usage.data(), sizeof(float), snap.core_usage.size(), out);
+    for (const Net &net : snap.nets)
+    {
+        HeadlessNet entry;
+        memset(&entry, 0, sizeof(entry));
+        memcpy(entry.name, net.name, IFNAMSIZ);
+        entry.rx_bytes = net.received.bytes;
+        entry.tx_bytes = net.transmited.bytes;
+        fwrite(&entry, sizeof(entry), 1, out);
+    }
+}
+
+/**
+ * Runs the collectors without any UI and writes every new snapshot to
+ * monitor_config.output, until SIGINT or SIGTERM, or until
+ * monitor_config.samples snapshots were written.
+ *
+ * @return The exit status of the monitor.
+ */
+int runHeadless()
+{
+    FILE *out = stdout;
+    if (strcmp(monitor_config.output, "-") != 0)
+    {
+        out = fopen(monitor_config.output, monitor_config.binary ? "wb" : "w");
+        if (out == nullptr)
+        {
+            perror(monitor_config.output);
+            return 1;
+        }
+    }
+    if (monitor_config.binary)
+    {
+        fwrite(HEADLESS_MAGIC, sizeof(HEADLESS_MAGIC), 1, out);
+        fwrite(&HEADLESS_VERSION, sizeof(HEADLESS_VERSION), 1, out);
+    }
+
+    // blocked before the sampler starts, so its threads inherit the mask and the signals come through signal_fd
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+    int signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+    headless_wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (signal_fd < 0 || headless_wake_fd < 0)
+    {
+        perror("headless");
+        return 1;
+    }
+
+    setSnapshotListener(wakeHeadless);
+    startSampler();
+
+    unsigned long long written = 0;
+    unsigned long long last_seq = 0;
+    struct pollfd fds[2] = {{headless_wake_fd, POLLIN, 0}, {signal_fd, POLLIN, 0}};
+    while (monitor_config.samples == 0 || written < monitor_config.samples)
+    {
+        if (poll(fds, 2, -1) < 0 && errno != EINTR)
+            break;
+        if (fds[1].revents & POLLIN)
+            break;
+        if (!(fds[0].revents & POLLIN))
+            continue;
+        uint64_t count;
+        if (read(headless_wake_fd, &count, sizeof(count)) < 0)
+            continue;
+
+        const Snapshot &snap = acquireSnapshot();
+        if (snap.seq == last_seq)
+            continue;
+        last_seq = snap.seq;
+        if (monitor_config.binary)
+            writeBinarySample(out, snap);
+        else
+            writeTextSample(out, snap);
+        fflush(out);
+        written++;
+    }
+
+    stopSampler();
+    if (out != stdout)
+        fclose(out);
+    close(signal_fd);
+    close(headless_wake_fd);
+    return 0;
+}
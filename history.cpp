@@ -0,0 +1,586 @@
+#include "header.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+
+// Time-series store of the metrics that have a history getter in collectors.cpp.
+// Every series keeps one ring per resolution of history_resolutions, each
+// covering the whole retention, so its memory is fixed at startup. A value is
+// added to the current bucket of every level at once: the 1 s level holds the
+// min/avg/max of the samples of each second, the coarser ones are the rollups
+// of the same samples over 10 s and 1 min. Buckets are aligned on the wall
+// clock. The sampler thread writes, the views read copies.
+//
+// A ring is made of blocks of HISTORY_BLOCK_POINTS buckets. The open block,
+// the one receiving values, is kept raw; when the next one opens it is
+// compressed by gorilla.cpp into its slot of the ring, and only the blocks a
+// read covers are decompressed. A slot has room for the raw block, but only
+// the pages its compressed data covers are ever touched, so the rest of the
+// slot costs neither memory nor, in the history file, disk.
+//
+// The rings live in a shared mapping of the history file, so they survive a
+// restart and are used in place when the file is opened again: nothing is
+// read or parsed, the pages come in as the plots touch them. The file is
+// columnar, one page-aligned column per series and level:
+//   HistoryFileHeader, then one HistorySeriesHeader per series, then the columns
+//   column: the open block, the HistoryBlock table, then the slots
+// A file whose layout does not match the current one is recreated, and the
+// magic is written last, so a file left half-created by a crash is recreated
+// too. A slot is invalidated while it is rewritten, and open_block is -1
+// between the closing of a block and the opening of the next, so neither is
+// read or closed again half-written after a crash.
+//
+// The rollups of 1 min and 10 min also keep a quantile sketch per bucket
+// (ddsketch.cpp), in a ring of their own after their column, so the
+// percentiles of any window are the merge of the sketches of a few buckets:
+// the 10 min ones inside the window, the 1 min ones at its ends. A sketch is
+// marked unused while it is cleared for a new bucket.
+
+static const int history_resolutions[HISTORY_LEVELS] = {1, 10, 60, 600};
+
+static const char HISTORY_MAGIC[4] = {'S', 'M', 'H', 'S'};
+static const unsigned HISTORY_VERSION = 6;
+// First level with sketches.
+static const int HISTORY_SKETCH_LEVEL = 2;
+
+// HistoryBlock.bytes of a block that did not compress below its raw size
+static const unsigned HISTORY_BLOCK_RAW = 0xffffffffu;
+static const size_t HISTORY_BLOCK_BYTES = HISTORY_BLOCK_POINTS * sizeof(HistoryPoint);
+
+struct HistoryFileHeader
+{
+    char magic[4];
+    unsigned version;
+    unsigned hours;
+    unsigned series_count;
+};
+
+struct HistorySeriesHeader
+{
+    char name[32]; // the metric
+    long long open_block[HISTORY_LEVELS]; // block held by the open block, -1 for none
+    unsigned long long offset[HISTORY_LEVELS]; // of the column, from the start of the file
+    unsigned long long blocks[HISTORY_LEVELS]; // slots of the column
+    unsigned long long sketches[HISTORY_LEVELS]; // offset of the sketch ring, 0 for a level without
+};
+
+// A slot of a ring, holding a closed block.
+struct HistoryBlock
+{
+    long long stamp; // block + 1, the block being bucket / HISTORY_BLOCK_POINTS of its first bucket, 0 for none
+    unsigned points; // buckets with values
+    unsigned bytes;  // compressed size, HISTORY_BLOCK_RAW when stored raw
+};
+
+// A bucket of a sketch ring.
+struct HistorySketch
+{
+    long long stamp; // bucket + 1, so that the zero of a new file is none
+    QuantileSketch sketch;
+};
+
+struct HistoryLevel
+{
+    HistoryPoint *open;   // the HISTORY_BLOCK_POINTS buckets of the open block
+    HistoryBlock *table;  // one per slot
+    unsigned char *slots; // HISTORY_BLOCK_BYTES each
+    long long blocks;
+    long long *open_block; // in the series header
+    HistorySketch *sketches; // nullptr for a level without
+    long long sketch_count;  // one per bucket of the retention
+    long long buckets;       // of the retention
+};
+
+struct Series
+{
+    const Metric *metric;
+    int collector;
+    HistoryLevel levels[HISTORY_LEVELS];
+};
+
+static mutex history_mutex;
+static vector<Series> history_series;
+static char *history_map = nullptr;
+static size_t history_map_size = 0;
+static int history_fd = -1; // holds the lock on the history file for the life of the monitor
+
+// A block decompressed by a read. A closed block never changes, so a plot
+// redrawn or panned over the same blocks decompresses none of them again.
+struct CachedBlock
+{
+    const HistoryLevel *level; // nullptr for an unused entry
+    long long block;
+    unsigned long long used; // history_cache_clock at the last read
+    HistoryPoint points[HISTORY_BLOCK_POINTS];
+};
+
+// Enough for the blocks covered by the widest plots of a few tabs.
+static const int HISTORY_CACHE_BLOCKS = 16;
+static CachedBlock history_cache[HISTORY_CACHE_BLOCKS];
+static unsigned long long history_cache_clock = 0;
+
+// Current CLOCK_REALTIME time in seconds.
+static long long realtimeSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec;
+}
+
+// $XDG_STATE_HOME/system-monitor.history, ~/.local/state when it is not set.
+static string defaultHistoryPath()
+{
+    const char *state = getenv("XDG_STATE_HOME");
+    if (state != nullptr && *state)
+        return string(state) + "/system-monitor.history";
+    const char *home = getenv("HOME");
+    if (home == nullptr)
+        return "";
+    mkdir((string(home) + "/.local").c_str(), 0755);
+    mkdir((string(home) + "/.local/state").c_str(), 0700);
+    return string(home) + "/.local/state/system-monitor.history";
+}
+
+// true if the mapping holds a complete file with the layout just computed.
+static bool historyLayoutMatches(const vector<size_t> &offsets, const vector<size_t> &sketch_offsets, unsigned hours)
+{
+    const HistoryFileHeader *header = (const HistoryFileHeader *)history_map;
+    if (memcmp(header->magic, HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) != 0 || header->version != HISTORY_VERSION ||
+        header->hours != hours || header->series_count != history_series.size())
+        return false;
+    const HistorySeriesHeader *headers = (const HistorySeriesHeader *)(header + 1);
+    for (size_t i = 0; i < history_series.size(); i++)
+    {
+        if (strncmp(headers[i].name, history_series[i].metric->name, sizeof(headers[i].name)) != 0)
+            return false;
+        for (int level = 0; level < HISTORY_LEVELS; level++)
+        {
+            if (headers[i].offset[level] != offsets[i * HISTORY_LEVELS + level] ||
+                headers[i].sketches[level] != sketch_offsets[i * HISTORY_LEVELS + level] ||
+                headers[i].blocks[level] != (unsigned long long)history_series[i].levels[level].blocks)
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Maps the rings of every metric with a history getter, from the history
+ * file when it holds the same series and retention, or empty.
+ * Must run before the sampler starts.
+ *
+ * @param hours The retention, the same for every resolution.
+ * @param path The history file, nullptr for the default one, "none" to keep the history in memory only.
+ */
+void initHistory(int hours, const char *path)
+{
+    lock_guard<mutex> lock(history_mutex);
+    history_series.clear();
+    for (CachedBlock &cached : history_cache)
+        cached.level = nullptr;
+    if (history_map != nullptr)
+        munmap(history_map, history_map_size);
+    history_map = nullptr;
+    if (history_fd >= 0)
+        close(history_fd);
+    history_fd = -1;
+
+    // layout: the headers, then the page-aligned columns
+    const size_t page = sysconf(_SC_PAGESIZE);
+    for (int i = 0; i < COLLECTOR_COUNT; i++)
+    {
+        for (const Metric *metric = collectors[i].metrics; metric->name; metric++)
+        {
+            if (metric->history != nullptr)
+                history_series.push_back({metric, i});
+        }
+    }
+    size_t offset = sizeof(HistoryFileHeader) + history_series.size() * sizeof(HistorySeriesHeader);
+    vector<size_t> offsets, sketch_offsets;
+    for (Series &series : history_series)
+    {
+        for (int level = 0; level < HISTORY_LEVELS; level++)
+        {
+            // the open block takes one slot of the retention, hence the extra one
+            long long buckets = hours * 3600LL / history_resolutions[level];
+            long long blocks = (buckets + HISTORY_BLOCK_POINTS - 1) / HISTORY_BLOCK_POINTS + 1;
+            series.levels[level].blocks = blocks;
+            series.levels[level].buckets = buckets;
+            offset = (offset + page - 1) / page * page;
+            offsets.push_back(offset);
+            offset += HISTORY_BLOCK_BYTES + blocks * sizeof(HistoryBlock);
+            offset = (offset + page - 1) / page * page;
+            offset += blocks * HISTORY_BLOCK_BYTES;
+            series.levels[level].sketch_count = level >= HISTORY_SKETCH_LEVEL ? buckets : 0;
+            offset = (offset + page - 1) / page * page;
+            sketch_offsets.push_back(level >= HISTORY_SKETCH_LEVEL ? offset : 0);
+            offset += series.levels[level].sketch_count * sizeof(HistorySketch);
+        }
+    }
+    history_map_size = offset;
+
+    string file = path == nullptr ? defaultHistoryPath() : path;
+    int fd = -1;
+    if (file != "" && file != "none")
+    {
+        fd = open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        // a second monitor keeps its history in memory rather than writing the same rings
+        if (fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) < 0)
+        {
+            fprintf(stderr, "%s is used by another monitor, history kept in memory\n", file.c_str());
+            close(fd);
+            fd = -1;
+        }
+        else if (fd < 0)
+            perror(file.c_str());
+    }
+    struct stat st;
+    bool reuse = fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size == history_map_size;
+    if (fd >= 0 && !reuse && (ftruncate(fd, 0) < 0 || ftruncate(fd, history_map_size) < 0))
+    {
+        perror(file.c_str());
+        close(fd);
+        fd = -1;
+    }
+    void *map = fd >= 0 ? mmap(nullptr, history_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                        : mmap(nullptr, history_map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+    {
+        perror("history");
+        if (fd >= 0)
+            close(fd);
+        history_series.clear();
+        return;
+    }
+    history_map = (char *)map;
+    history_fd = fd;
+
+    HistoryFileHeader *header = (HistoryFileHeader *)history_map;
+    HistorySeriesHeader *headers = (HistorySeriesHeader *)(header + 1);
+    for (size_t i = 0; i < history_series.size(); i++)
+    {
+        for (int level = 0; level < HISTORY_LEVELS; level++)
+        {
+            HistoryLevel &history = history_series[i].levels[level];
+            char *column = history_map + offsets[i * HISTORY_LEVELS + level];
+            size_t table_end = HISTORY_BLOCK_BYTES + history.blocks * sizeof(HistoryBlock);
+            history.open = (HistoryPoint *)column;
+            history.table = (HistoryBlock *)(column + HISTORY_BLOCK_BYTES);
+            history.slots = (unsigned char *)column + (table_end + page - 1) / page * page;
+            history.open_block = &headers[i].open_block[level];
+            size_t sketches = sketch_offsets[i * HISTORY_LEVELS + level];
+            history.sketches = sketches ? (HistorySketch *)(history_map + sketches) : nullptr;
+        }
+    }
+    if (reuse && historyLayoutMatches(offsets, sketch_offsets, hours))
+        return;
+
+    // a new file, or one with another layout: written empty, the magic last.
+    // A file truncated to 0 and back reads as zero without a page being
+    // allocated, as does an anonymous mapping. Only the headers are written:
+    // a zero slot or sketch stamp is none, so the columns are not touched.
+    if (reuse && (ftruncate(fd, 0) < 0 || ftruncate(fd, history_map_size) < 0))
+        memset(history_map, 0, history_map_size);
+    for (size_t i = 0; i < history_series.size(); i++)
+    {
+        strncpy(headers[i].name, history_series[i].metric->name, sizeof(headers[i].name) - 1);
+        for (int level = 0; level < HISTORY_LEVELS; level++)
+        {
+            HistoryLevel &history = history_series[i].levels[level];
+            headers[i].open_block[level] = -1;
+            headers[i].offset[level] = offsets[i * HISTORY_LEVELS + level];
+            headers[i].blocks[level] = history.blocks;
+            headers[i].sketches[level] = sketch_offsets[i * HISTORY_LEVELS + level];
+        }
+    }
+    header->version = HISTORY_VERSION;
+    header->hours = hours;
+    header->series_count = history_series.size();
+    if (fd >= 0)
+        msync(history_map, history_map_size, MS_SYNC);
+    memcpy(header->magic, HISTORY_MAGIC, sizeof(HISTORY_MAGIC));
+}
+
+// Compresses the open block into its slot, stored raw when it does not get smaller.
+static void closeBlock(HistoryLevel &level)
+{
+    long long block = *level.open_block;
+    long long slot = block % level.blocks;
+    HistoryBlock &entry = level.table[slot];
+    unsigned char *data = level.slots + slot * HISTORY_BLOCK_BYTES;
+    entry.stamp = 0;
+    unsigned points;
+    size_t bytes;
+    if (compressHistoryBlock(level.open, data, HISTORY_BLOCK_BYTES, points, bytes))
+        entry.bytes = bytes;
+    else
+    {
+        memcpy(data, level.open, HISTORY_BLOCK_BYTES);
+        entry.bytes = HISTORY_BLOCK_RAW;
+        points = count_if(level.open, level.open + HISTORY_BLOCK_POINTS, [](const HistoryPoint &p) { return p.count != 0; });
+    }
+    entry.points = points;
+    entry.stamp = block + 1;
+}
+
+// Empties a level, and the decompressed blocks kept from it.
+static void discardLevel(HistoryLevel &level)
+{
+    *level.open_block = -1;
+    for (long long slot = 0; slot < level.blocks; slot++)
+        level.table[slot].stamp = 0;
+    for (long long bucket = 0; bucket < level.sketch_count; bucket++)
+        level.sketches[bucket].stamp = 0;
+    for (CachedBlock &cached : history_cache)
+        if (cached.level == &level)
+            cached.level = nullptr;
+}
+
+// Adds a value to the bucket of second, closing the open block when the bucket is past it.
+static void addToLevel(HistoryLevel &level, int resolution, long long second, float value)
+{
+    long long bucket = second / resolution;
+    long long block = bucket / HISTORY_BLOCK_POINTS;
+    if (block < *level.open_block)
+    {
+        // the clock went back; more than the retention, as after a file written
+        // with a clock ahead, and the level starts over rather than waiting
+        if (*level.open_block * HISTORY_BLOCK_POINTS - bucket <= level.buckets)
+            return;
+        discardLevel(level);
+    }
+    if (block != *level.open_block)
+    {
+        // the blocks skipped keep the slots of older blocks, which readers tell apart by number
+        if (*level.open_block >= 0)
+            closeBlock(level);
+        *level.open_block = -1;
+        memset(level.open, 0, HISTORY_BLOCK_BYTES);
+        *level.open_block = block;
+    }
+    HistoryPoint &point = level.open[bucket % HISTORY_BLOCK_POINTS];
+    point.min = point.count ? min(point.min, value) : value;
+    point.max = point.count ? max(point.max, value) : value;
+    point.sum += value;
+    point.count++;
+
+    if (level.sketches == nullptr)
+        return;
+    HistorySketch &sketch = level.sketches[bucket % level.sketch_count];
+    if (sketch.stamp != bucket + 1)
+    {
+        sketch.stamp = 0;
+        clearSketch(sketch.sketch);
+        sketch.stamp = bucket + 1;
+    }
+    addToSketch(sketch.sketch, value);
+}
+
+/**
+ * Adds the history metrics of a collector that just ran to the store.
+ *
+ * @param collector The index of the collector in collectors.
+ * @param state The snapshot it wrote.
+ */
+void recordHistory(int collector, const Snapshot &state)
+{
+    long long now = realtimeSeconds();
+    lock_guard<mutex> lock(history_mutex);
+    for (Series &series : history_series)
+    {
+        if (series.collector != collector)
+            continue;
+        float value = series.metric->history(state);
+        for (int level = 0; level < HISTORY_LEVELS; level++)
+            addToLevel(series.levels[level], history_resolutions[level], now, value);
+    }
+}
+
+// Index of the series of a metric, -1 if the metric has no history.
+int findSeries(const char *name)
+{
+    for (size_t i = 0; i < history_series.size(); i++)
+        if (strcmp(history_series[i].metric->name, name) == 0)
+            return i;
+    return -1;
+}
+
+int historySeriesCount()
+{
+    return history_series.size();
+}
+
+const char *historySeriesName(int series)
+{
+    return history_series[series].metric->name;
+}
+
+// Seconds covered by one bucket of a level.
+int historyResolution(int level)
+{
+    return history_resolutions[level];
+}
+
+// The buckets of a block, decompressed through the cache when needed, nullptr when the ring does not hold it.
+static const HistoryPoint *blockPoints(const HistoryLevel &level, long long block)
+{
+    long long open = *level.open_block;
+    if (block == open)
+        return level.open;
+    if (open < 0 || block >= open || block <= open - level.blocks)
+        return nullptr;
+    long long slot = block % level.blocks;
+    const HistoryBlock &entry = level.table[slot];
+    const unsigned char *data = level.slots + slot * HISTORY_BLOCK_BYTES;
+    if (entry.stamp != block + 1)
+        return nullptr;
+    if (entry.bytes == HISTORY_BLOCK_RAW)
+        return (const HistoryPoint *)data;
+    CachedBlock *oldest = &history_cache[0];
+    for (CachedBlock &cached : history_cache)
+    {
+        if (cached.level == &level && cached.block == block)
+        {
+            cached.used = ++history_cache_clock;
+            return cached.points;
+        }
+        if (cached.used < oldest->used)
+            oldest = &cached;
+    }
+    decompressHistoryBlock(data, entry.bytes, entry.points, oldest->points);
+    oldest->level = &level;
+    oldest->block = block;
+    oldest->used = ++history_cache_clock;
+    return oldest->points;
+}
+
+/**
+ * Folds the buckets of a series over a time window into columns, the min of
+ * their mins, the max of their maxes and the sums of their sums and counts,
+ * for plots drawing one min/max pair per pixel. The level read is the coarsest
+ * one whose buckets are no wider than a column: a column never gets more than
+ * the ratio between two levels of buckets, whatever the span of the window.
+ * Only the blocks covering the window are decompressed.
+ *
+ * @param series An index given by findSeries().
+ * @param start Start of the window, in CLOCK_REALTIME seconds.
+ * @param span Length of the window in seconds.
+ * @param columns Number of columns the window is cut in.
+ * @param out Receives columns points, count 0 for a column without values. Its capacity is reused.
+ * @return The level read.
+ */
+int readHistoryColumns(int series, double start, double span, int columns, vector<HistoryPoint> &out)
+{
+    out.assign(max(columns, 0), HistoryPoint());
+    if (series < 0 || columns <= 0 || span <= 0)
+        return 0;
+    double column_span = span / columns;
+    int level = 0;
+    while (level + 1 < HISTORY_LEVELS && history_resolutions[level + 1] <= column_span)
+        level++;
+    int resolution = history_resolutions[level];
+    long long first = max((long long)floor(start / resolution), 0LL);
+    long long last = (long long)floor((start + span) / resolution);
+    lock_guard<mutex> lock(history_mutex);
+    const HistoryLevel &history = history_series[series].levels[level];
+    for (long long block = first / HISTORY_BLOCK_POINTS; block <= last / HISTORY_BLOCK_POINTS; block++)
+    {
+        const HistoryPoint *points = blockPoints(history, block);
+        if (points == nullptr)
+            continue;
+        long long from = max(first, block * HISTORY_BLOCK_POINTS);
+        long long to = min(last, block * HISTORY_BLOCK_POINTS + HISTORY_BLOCK_POINTS - 1);
+        for (long long bucket = from; bucket <= to; bucket++)
+        {
+            const HistoryPoint &p = points[bucket % HISTORY_BLOCK_POINTS];
+            if (p.count == 0)
+                continue;
+            int column = min(max((int)((bucket * resolution - start) / column_span), 0), columns - 1);
+            HistoryPoint &c = out[column];
+            c.min = c.count ? min(c.min, p.min) : p.min;
+            c.max = c.count ? max(c.max, p.max) : p.max;
+            c.sum += p.sum;
+            c.count += p.count;
+        }
+    }
+    return level;
+}
+
+/**
+ * Reads the quantiles of the values of a series over a window, from the
+ * sketches of the 1 min and 10 min buckets it overlaps: the window is widened
+ * to whole minutes. At most 18 sketches of 1 min and one per 10 min of the
+ * window are merged.
+ *
+ * @param series An index given by findSeries().
+ * @param start Start of the window, in CLOCK_REALTIME seconds.
+ * @param span Length of the window in seconds.
+ * @param quantiles n quantiles between 0 and 1, in increasing order.
+ * @param out Receives the n values, 0 when the window holds none.
+ * @return The number of values in the window.
+ */
+unsigned long long historyQuantiles(int series, double start, double span, const double *quantiles, int n, float *out)
+{
+    static SketchSum sum;
+    fill(out, out + n, 0.0f);
+    if (series < 0 || span <= 0)
+        return 0;
+    const int minute = history_resolutions[HISTORY_SKETCH_LEVEL];
+    const int ratio = history_resolutions[HISTORY_SKETCH_LEVEL + 1] / minute;
+    long long first = max((long long)floor(start / minute), 0LL);
+    long long last = (long long)ceil((start + span) / minute) - 1;
+    lock_guard<mutex> lock(history_mutex);
+    const HistoryLevel &minutes = history_series[series].levels[HISTORY_SKETCH_LEVEL];
+    const HistoryLevel &tens = history_series[series].levels[HISTORY_SKETCH_LEVEL + 1];
+    clearSketchSum(sum);
+    for (long long bucket = first; bucket <= last;)
+    {
+        if (bucket % ratio == 0 && bucket + ratio - 1 <= last)
+        {
+            const HistorySketch &sketch = tens.sketches[bucket / ratio % tens.sketch_count];
+            if (sketch.stamp == bucket / ratio + 1)
+            {
+                mergeSketch(sum, sketch.sketch);
+                bucket += ratio;
+                continue;
+            }
+        }
+        const HistorySketch &sketch = minutes.sketches[bucket % minutes.sketch_count];
+        if (sketch.stamp == bucket + 1)
+            mergeSketch(sum, sketch.sketch);
+        bucket++;
+    }
+    sketchQuantiles(sum, quantiles, n, out);
+    return sum.count;
+}
+
+/**
+ * Sums the closed blocks of a series over every level, for the compression
+ * ratio shown in the overhead window.
+ *
+ * @param points Receives the number of buckets with values they hold.
+ * @param bytes Receives their stored size.
+ */
+void historyCompression(int series, size_t &points, size_t &bytes)
+{
+    points = 0;
+    bytes = 0;
+    lock_guard<mutex> lock(history_mutex);
+    for (const HistoryLevel &level : history_series[series].levels)
+    {
+        for (long long slot = 0; slot < level.blocks; slot++)
+        {
+            const HistoryBlock &entry = level.table[slot];
+            if (entry.stamp == 0 || entry.stamp - 1 <= *level.open_block - level.blocks)
+                continue;
+            points += entry.points;
+            bytes += entry.bytes == HISTORY_BLOCK_RAW ? HISTORY_BLOCK_BYTES : entry.bytes;
+        }
+    }
+}
+
+// Bytes of the mapping holding the rings of every series, most of it never touched.
+size_t historyBytes()
+{
+    return history_map_size;
+}
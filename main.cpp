@@ -42,6 +42,26 @@ using namespace gl;
 #endif
 
 
+// the loop wakes up and draws a frame at least this often even when nothing happens
+static const int IDLE_WAKEUP_MS = 1000;
+
+// SDL user event pushed by the sampler thread, and whether one is already queued
+static Uint32 snapshot_event = (Uint32)-1;
+static atomic<bool> snapshot_wake_pending(false);
+
+// frames drawn per second, measured by the main loop
+static float frames_per_second = 0.0f;
+
+// Called on the sampler thread for every new snapshot, queues at most one wake-up event.
+static void wakeRenderLoop()
+{
+    if (snapshot_wake_pending.exchange(true))
+        return;
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = snapshot_event;
+    SDL_PushEvent(&event);
+}
 
 // systemWindow, display information for the system monitorization
 void systemWindow(const char *id, ImVec2 size, ImVec2 position)
@@ -50,14 +70,15 @@ void systemWindow(const char *id, ImVec2 size, ImVec2 position)
     ImGui::SetWindowSize(id, size);
     ImGui::SetWindowPos(id, position);
     // student TODO : add code here for the system window
-    ImGui::Text("Operating system used: %s",getOsName());
-
-    char host_name[HOST_NAME_MAX+1];
-    gethostname(host_name, HOST_NAME_MAX+1);
-    ImGui::Text("Computer name: %s", host_name);
-    ImGui::Text("User logged in: %s", getlogin());
-    ImGui::Text("Number of working processes: %d", getProcesses());
-    ImGui::Text("CPU: %s",CPUinfo().c_str());
+    const Snapshot &snap = getSnapshot();
+    const SystemInfo &info = snap.info;
+    ImGui::Text("Operating system used: %s %s", info.os ? info.os : "", info.kernel_release.c_str());
+    ImGui::Text("Computer name: %s", info.hostname.c_str());
+    ImGui::Text("User logged in: %s", info.user.c_str());
+    ImGui::Text("Number of working processes: %d", snap.process_count);
+    ImGui::Text("CPU: %s",info.cpu_brand.c_str());
+    ImGui::Text("Cores: %d         Threads: %d", info.cores, info.threads);
+    ImGui::Text("Monitor CPU: %.1f%%         Frames: %.1f/s", snap.monitor_cpu, frames_per_second);
 
     for(int i = 0; i <=4; i++ )
     {
@@ -66,7 +87,11 @@ void systemWindow(const char *id, ImVec2 size, ImVec2 position)
     ImGui::Separator();
 
 
-    drawTabbedContainer();
+    drawTabbedContainer(snap);
+
+    ImGui::Spacing();
+    ImGui::Separator();
+    drawSamplerStats(snap);
 
     ImGui::End();
 }
@@ -79,11 +104,13 @@ void memoryProcessesWindow(const char *id, ImVec2 size, ImVec2 position)
     ImGui::SetWindowPos(id, position);
 
     // student TODO : add code here for the memory and process information
-    getMemory();
-    getDiskUsage();
+    const Snapshot &snap = getSnapshot();
+    drawMemory(snap);
+    drawDiskUsage(snap);
     ImGui::Separator();
 
-    getProcessTable();
+    drawProcessTable(snap);
+    drawProcessEvents(snap);
     
     ImGui::End();
 }
@@ -96,6 +123,7 @@ void networkWindow(const char *id, ImVec2 size, ImVec2 position)
     ImGui::SetWindowPos(id, position);
 
     // student TODO : add code here for the network information
+    const Snapshot &snap = getSnapshot();
     time_t current_time;
     struct tm *timeinfo;
     time(&current_time);
@@ -105,26 +133,40 @@ void networkWindow(const char *id, ImVec2 size, ImVec2 position)
     ImGui::Spacing();
     ImGui::Separator();
 
-    Networks networks;
-
-    getIpv4Network(&networks);
+    drawIpv4Network(snap.networks);
+    drawLinks(snap.networks);
     ImGui::Spacing();
     ImGui::Separator();
     ImGui::Spacing();
 
-    getNetworkTable(&networks);
+    drawNetworkTable(snap);
 
     ImGui::Spacing();
     ImGui::Separator();
     ImGui::Spacing();
-    drawNetworkTabbed();
+    drawNetworkTabbed(snap);
+
+    ImGui::End();
+}
 
+// overheadWindow, what the monitor itself costs, starts collapsed on top of the others
+void overheadWindow(const char *id, ImVec2 size, ImVec2 position)
+{
+    ImGui::SetNextWindowCollapsed(true, ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(size, ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowPos(position, ImGuiCond_FirstUseEver);
+    if (ImGui::Begin(id))
+        drawOverhead(getSnapshot(), frames_per_second);
     ImGui::End();
 }
 
 // Main code
-int main(int, char **)
+int main(int argc, char **argv)
 {
+    if (!parseArguments(argc, argv))
+        return 1;
+    if (monitor_config.headless)
+        return runHeadless();
 
     // Setup SDL
     // (Some versions of SDL before <2.0.10 appears to have performance/stalling issues on a minority of Windows systems,
@@ -193,43 +235,105 @@ int main(int, char **)
     // note : you are free to change the style of the application
     ImVec4 clear_color = ImVec4(0.0f, 0.0f, 0.0f, 0.0f);
 
-    // Main loop
+    // Collection runs on its own thread, the loop below only draws snapshots.
+    // The sampler wakes the loop with a user event when it publishes one.
+    snapshot_event = SDL_RegisterEvents(1);
+    setSnapshotListener(wakeRenderLoop);
+    startSampler();
+
+    // Main loop: sleeps until input arrives or a snapshot is published, draws
+    // nothing while the window is minimized or hidden, and never more than max_fps frames per second.
+    const Uint32 frame_ms = 1000 / monitor_config.max_fps;
+    Uint32 last_frame_ms = 0;
+    Uint32 fps_start_ms = SDL_GetTicks();
+    int fps_frames = 0;
+    int frames_needed = 1;
     bool done = false;
     while (!done)
     {
+        bool visible = !(SDL_GetWindowFlags(window) & (SDL_WINDOW_MINIMIZED | SDL_WINDOW_HIDDEN));
+        int timeout = IDLE_WAKEUP_MS;
+        if (visible && frames_needed > 0)
+            timeout = max(0, (int)(last_frame_ms + frame_ms - SDL_GetTicks()));
+
         // Poll and handle events (inputs, window resize, etc.)
         // You can read the io.WantCaptureMouse, io.WantCaptureKeyboard flags to tell if dear imgui wants to use your inputs.
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
         // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
         // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
         SDL_Event event;
-        while (SDL_PollEvent(&event))
+        bool have_event = SDL_WaitEventTimeout(&event, timeout);
+        // an idle wake-up redraws the frames per second and the other time-driven text
+        if (!have_event && visible && frames_needed == 0)
+            frames_needed = 1;
+        while (have_event)
         {
-            ImGui_ImplSDL2_ProcessEvent(&event);
-            if (event.type == SDL_QUIT)
-                done = true;
-            if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(window))
-                done = true;
+            if (event.type == snapshot_event)
+            {
+                snapshot_wake_pending.store(false);
+                frames_needed = max(frames_needed, 1);
+            }
+            else
+            {
+                ImGui_ImplSDL2_ProcessEvent(&event);
+                if (event.type == SDL_QUIT)
+                    done = true;
+                if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(window))
+                    done = true;
+                // a second frame lets ImGui settle hover and layout changes caused by the input
+                frames_needed = 2;
+            }
+            have_event = SDL_PollEvent(&event);
         }
 
+        if (!visible || frames_needed == 0 || SDL_GetTicks() - last_frame_ms < frame_ms)
+            continue;
+        frames_needed--;
+        last_frame_ms = SDL_GetTicks();
+        fps_frames++;
+        if (last_frame_ms - fps_start_ms >= 1000)
+        {
+            frames_per_second = fps_frames * 1000.0f / (last_frame_ms - fps_start_ms);
+            fps_start_ms = last_frame_ms;
+            fps_frames = 0;
+        }
+
+        long long frame_start = monotonicNs();
+        unsigned long long frame_allocations = threadAllocationCount();
+
         // Start the Dear ImGui frame
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplSDL2_NewFrame(window);
         ImGui::NewFrame();
 
+        // Take the newest snapshot once, so all windows of a frame show the same sample
+        acquireSnapshot();
+
         {
             ImVec2 mainDisplay = io.DisplaySize;
+            long long window_start = monotonicNs();
             memoryProcessesWindow("== Memory and Processes ==",
                                   ImVec2((mainDisplay.x / 2) - 20, (mainDisplay.y / 2) + 30),
                                   ImVec2((mainDisplay.x / 2) + 10, 10));
+            long long window_end = monotonicNs();
+            recordProbe(PROBE_MEMORY_WINDOW, window_end - window_start);
             // --------------------------------------
+            window_start = window_end;
             systemWindow("== System ==",
                          ImVec2((mainDisplay.x / 2) - 10, (mainDisplay.y / 2) + 30),
                          ImVec2(10, 10));
+            window_end = monotonicNs();
+            recordProbe(PROBE_SYSTEM_WINDOW, window_end - window_start);
             // --------------------------------------
+            window_start = window_end;
             networkWindow("== Network ==",
                           ImVec2(mainDisplay.x - 20, (mainDisplay.y / 2) - 60),
                           ImVec2(10, (mainDisplay.y / 2) + 50));
+            recordProbe(PROBE_NETWORK_WINDOW, monotonicNs() - window_start);
+            // --------------------------------------
+            overheadWindow("== Monitor overhead ==",
+                           ImVec2(mainDisplay.x / 2, mainDisplay.y / 2),
+                           ImVec2(mainDisplay.x / 4, mainDisplay.y / 4));
         }
 
         // Rendering
@@ -239,9 +343,12 @@ int main(int, char **)
         glClear(GL_COLOR_BUFFER_BIT);
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         SDL_GL_SwapWindow(window);
+        recordProbe(PROBE_FRAME, monotonicNs() - frame_start);
+        recordProbe(PROBE_FRAME_ALLOCATIONS, threadAllocationCount() - frame_allocations);
     }
 
     // Cleanup
+    stopSampler();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
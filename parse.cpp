@@ -0,0 +1,485 @@
+#include "header.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MONITOR_X86_SIMD
+#endif
+
+// Hand-written parsers for the /proc text formats.
+// They walk a pointer over the buffer filled by readProcFile()/readSmallFile(),
+// never allocate, and never read past end.
+
+// Skips blanks (spaces and tabs), stops at a newline.
+const char *skipSpaces(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+// Returns the first character of the next line, or end.
+const char *nextLine(const char *p, const char *end)
+{
+    const char *nl = (const char *)memchr(p, '\n', end - p);
+    return (nl != nullptr) ? nl + 1 : end;
+}
+
+/**
+ * Reads an unsigned decimal number, after skipping blanks.
+ *
+ * @param p Where to start.
+ * @param end The end of the buffer.
+ * @param out The number, 0 if there are no digits.
+ * @return The first character after the number.
+ */
+const char *scanU64(const char *p, const char *end, unsigned long long &out)
+{
+    p = skipSpaces(p, end);
+    unsigned long long value = 0;
+    while (p < end && (unsigned)(*p - '0') < 10)
+    {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    out = value;
+    return p;
+}
+
+// Same as scanU64, with an optional leading '-'.
+const char *scanI64(const char *p, const char *end, long long &out)
+{
+    p = skipSpaces(p, end);
+    bool negative = (p < end && *p == '-');
+    if (negative)
+        p++;
+    unsigned long long value;
+    p = scanU64(p, end, value);
+    out = negative ? -(long long)value : (long long)value;
+    return p;
+}
+
+// Reads a decimal number with an optional fraction, like the ones of /proc/uptime.
+const char *scanDouble(const char *p, const char *end, double &out)
+{
+    unsigned long long whole;
+    p = scanU64(p, end, whole);
+    double value = whole;
+    if (p < end && *p == '.')
+    {
+        p++;
+        double scale = 0.1;
+        while (p < end && (unsigned)(*p - '0') < 10)
+        {
+            value += (*p - '0') * scale;
+            scale *= 0.1;
+            p++;
+        }
+    }
+    out = value;
+    return p;
+}
+
+// ---------------------------------------------------------------------------
+// Field scanner shared by the /proc/stat, /proc/net/dev and /proc/[pid]/stat parsers.
+// scanFields() reads the blank separated numeric fields of one line. The x86
+// versions find the field boundaries 16 (SSE2) or 32 (AVX2) bytes at a time,
+// the AVX2 one also converts up to 16 digits at once. The best one the CPU
+// supports is picked at startup, the scalar one is used everywhere else.
+
+static inline bool isDigit(char c)
+{
+    return (unsigned)(c - '0') < 10;
+}
+
+// Converts one field: an optional '-' then digits. Negative values are returned in two's complement.
+static inline unsigned long long convertField(const char *p, const char *end)
+{
+    bool negative = (p < end && *p == '-');
+    if (negative)
+        p++;
+    unsigned long long value = 0;
+    while (p < end && isDigit(*p))
+        value = value * 10 + (*p++ - '0');
+    return negative ? -value : value;
+}
+
+/**
+ * Scalar scanner, also finishes the last bytes for the SIMD versions.
+ *
+ * @param in_field true if the byte before p belongs to a field.
+ */
+static size_t scanFieldsTail(const char *&p, const char *end, unsigned long long *out, size_t max, bool in_field)
+{
+    size_t n = 0;
+    while (p < end && *p != '\n')
+    {
+        bool blank = (*p == ' ' || *p == '\t');
+        if (!blank && !in_field)
+        {
+            if (n == max)
+                break;
+            out[n++] = convertField(p, end);
+        }
+        in_field = !blank;
+        p++;
+    }
+    p = nextLine(p, end);
+    return n;
+}
+
+static size_t scanFieldsScalar(const char *&p, const char *end, unsigned long long *out, size_t max)
+{
+    return scanFieldsTail(p, end, out, max, false);
+}
+
+#ifdef MONITOR_X86_SIMD
+__attribute__((target("sse2"))) static size_t scanFieldsSSE2(const char *&p, const char *end, unsigned long long *out, size_t max)
+{
+    const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), newline = _mm_set1_epi8('\n');
+    size_t n = 0;
+    unsigned prev_blank = 1;
+    while (end - p >= 16)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)p);
+        unsigned nl_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(c, newline));
+        unsigned blank_mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(c, space), _mm_cmpeq_epi8(c, tab))) | nl_mask;
+        // a field starts on a non blank byte that follows a blank one
+        unsigned starts = ~blank_mask & ((blank_mask << 1) | prev_blank) & 0xffff;
+        if (nl_mask != 0)
+            starts &= (nl_mask & -nl_mask) - 1;
+        while (starts != 0)
+        {
+            if (n == max)
+            {
+                p = nextLine(p, end);
+                return n;
+            }
+            out[n++] = convertField(p + __builtin_ctz(starts), end);
+            starts &= starts - 1;
+        }
+        if (nl_mask != 0)
+        {
+            p += __builtin_ctz(nl_mask) + 1;
+            return n;
+        }
+        prev_blank = (blank_mask >> 15) & 1;
+        p += 16;
+    }
+    return n + scanFieldsTail(p, end, out + n, max - n, !prev_blank);
+}
+
+// pshufb masks moving the first len bytes to the end of the register, zeroing the rest
+alignas(16) static unsigned char digit_shuffle[17][16];
+
+static bool initDigitShuffle()
+{
+    for (int len = 0; len <= 16; len++)
+        for (int i = 0; i < 16; i++)
+            digit_shuffle[len][i] = (i < 16 - len) ? 0x80 : i - (16 - len);
+    return true;
+}
+
+// Converts up to 16 digits in one go: bytes to digits, then pairs, quads and octets of digits are combined with multiply-adds.
+__attribute__((target("avx2"))) static inline unsigned long long convertFieldAVX2(const char *p, const char *end)
+{
+    bool negative = (p < end && *p == '-');
+    if (negative)
+        p++;
+    if (end - p < 16)
+        return negative ? -convertField(p, end) : convertField(p, end);
+
+    __m128i digits = _mm_sub_epi8(_mm_loadu_si128((const __m128i *)p), _mm_set1_epi8('0'));
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digits, _mm_set1_epi8(9)), digits);
+    unsigned len = __builtin_ctz(~(unsigned)_mm_movemask_epi8(is_digit));
+    if (len == 16)
+        return negative ? -convertField(p, end) : convertField(p, end);
+
+    digits = _mm_shuffle_epi8(digits, _mm_load_si128((const __m128i *)digit_shuffle[len]));
+    __m128i pairs = _mm_maddubs_epi16(digits, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+    __m128i quads = _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+    quads = _mm_packus_epi32(quads, quads);
+    __m128i octets = _mm_madd_epi16(quads, _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+    unsigned long long value = (unsigned long long)(unsigned)_mm_cvtsi128_si32(octets) * 100000000ULL + (unsigned)_mm_extract_epi32(octets, 1);
+    return negative ? -value : value;
+}
+
+__attribute__((target("avx2"))) static size_t scanFieldsAVX2(const char *&p, const char *end, unsigned long long *out, size_t max)
+{
+    const __m256i space = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t'), newline = _mm256_set1_epi8('\n');
+    size_t n = 0;
+    unsigned prev_blank = 1;
+    while (end - p >= 32)
+    {
+        __m256i c = _mm256_loadu_si256((const __m256i *)p);
+        unsigned nl_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(c, newline));
+        unsigned blank_mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(c, space), _mm256_cmpeq_epi8(c, tab))) | nl_mask;
+        unsigned starts = ~blank_mask & ((blank_mask << 1) | prev_blank);
+        if (nl_mask != 0)
+            starts &= (nl_mask & -nl_mask) - 1;
+        while (starts != 0)
+        {
+            if (n == max)
+            {
+                p = nextLine(p, end);
+                return n;
+            }
+            out[n++] = convertFieldAVX2(p + __builtin_ctz(starts), end);
+            starts &= starts - 1;
+        }
+        if (nl_mask != 0)
+        {
+            p += __builtin_ctz(nl_mask) + 1;
+            return n;
+        }
+        prev_blank = blank_mask >> 31;
+        p += 32;
+    }
+    return n + scanFieldsTail(p, end, out + n, max - n, !prev_blank);
+}
+#endif
+
+typedef size_t (*ScanFieldsFn)(const char *&p, const char *end, unsigned long long *out, size_t max);
+
+struct ScanFieldsBackend
+{
+    const char *name;
+    ScanFieldsFn fn;
+    bool (*supported)();
+};
+
+static const ScanFieldsBackend scan_fields_backends[] = {
+#ifdef MONITOR_X86_SIMD
+    {"avx2", scanFieldsAVX2, [] { return initDigitShuffle() && __builtin_cpu_supports("avx2"); }},
+    {"sse2", scanFieldsSSE2, [] { return (bool)__builtin_cpu_supports("sse2"); }},
+#endif
+    {"scalar", scanFieldsScalar, [] { return true; }},
+};
+
+static const ScanFieldsBackend *pickScanFieldsBackend()
+{
+    for (const ScanFieldsBackend &backend : scan_fields_backends)
+        if (backend.supported())
+            return &backend;
+    return nullptr;
+}
+
+static const ScanFieldsBackend *scan_fields_backend = pickScanFieldsBackend();
+
+/**
+ * Reads the blank separated numeric fields of the line starting at p.
+ * A field is an optional '-' followed by digits, negative values are stored in
+ * two's complement. Reading stops at the end of the line or after max fields.
+ *
+ * @param p Where to start, moved to the beginning of the next line.
+ * @param end The end of the buffer, nothing after it is read.
+ * @param out Receives the fields.
+ * @param max The size of out.
+ * @return The number of fields read.
+ */
+size_t scanFields(const char *&p, const char *end, unsigned long long *out, size_t max)
+{
+    return scan_fields_backend->fn(p, end, out, max);
+}
+
+// Name of the scanFields() implementation in use.
+const char *scanFieldsBackend()
+{
+    return scan_fields_backend->name;
+}
+
+/**
+ * Switches scanFields() to another implementation, used by the benchmarks.
+ *
+ * @param name "avx2", "sse2" or "scalar".
+ * @return false if the implementation does not exist or the CPU does not support it.
+ */
+bool useScanFieldsBackend(const char *name)
+{
+    for (const ScanFieldsBackend &backend : scan_fields_backends)
+    {
+        if (strcmp(backend.name, name) == 0 && backend.supported())
+        {
+            scan_fields_backend = &backend;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+
+// Copies the up to 10 counters of a /proc/stat cpu line into a CPUStats.
+static void setCPUStats(CPUStats &cpu_s, const unsigned long long *fields, size_t n)
+{
+    long long *counters[] = {&cpu_s.user, &cpu_s.nice, &cpu_s.system, &cpu_s.idle, &cpu_s.iowait,
+                             &cpu_s.irq, &cpu_s.softirq, &cpu_s.steal, &cpu_s.guest, &cpu_s.guestNice};
+    for (size_t i = 0; i < 10; i++)
+        *counters[i] = (i < n) ? fields[i] : 0;
+}
+
+/**
+ * Parses the "cpu" lines of /proc/stat: the aggregated one, then one per core.
+ * Parsing stops at the first line that is not a cpu line, so the long intr
+ * and softirq lines are never scanned.
+ *
+ * @param cores Resized to the number of cpuN lines.
+ * @return false if the buffer does not start with the cpu line.
+ */
+bool parseCPUStat(const char *buf, size_t len, CPUStats &cpu_s, vector<CPUStats> &cores)
+{
+    const char *p = buf, *end = buf + len;
+    if (len < 4 || memcmp(p, "cpu ", 4) != 0)
+        return false;
+
+    unsigned long long fields[10];
+    p += 4;
+    setCPUStats(cpu_s, fields, scanFields(p, end, fields, 10));
+
+    size_t count = 0;
+    while (end - p > 3 && memcmp(p, "cpu", 3) == 0)
+    {
+        // skip the cpuN label
+        while (p < end && *p != ' ')
+            p++;
+        if (count == cores.size())
+            cores.emplace_back();
+        setCPUStats(cores[count++], fields, scanFields(p, end, fields, 10));
+    }
+    cores.resize(count);
+    return true;
+}
+
+/**
+ * Parses the MemTotal, MemAvailable, SwapTotal and SwapFree lines of /proc/meminfo.
+ * Like before, used_ram and used_swap are computed from the available/free values.
+ *
+ * @return false if one of the four lines is missing.
+ */
+bool parseMeminfo(const char *buf, size_t len, Memory &mem)
+{
+    const char *p = buf, *end = buf + len;
+    long long available = 0, swap_free = 0;
+    int found = 0;
+    while (p < end && found != 0xf)
+    {
+        const char *colon = (const char *)memchr(p, ':', end - p);
+        if (colon == nullptr)
+            break;
+        size_t key_len = colon - p;
+        long long *value = nullptr;
+        int bit = 0;
+        if (key_len == 8 && memcmp(p, "MemTotal", 8) == 0)
+            value = &mem.total_ram, bit = 1;
+        else if (key_len == 12 && memcmp(p, "MemAvailable", 12) == 0)
+            value = &available, bit = 2;
+        else if (key_len == 9 && memcmp(p, "SwapTotal", 9) == 0)
+            value = &mem.total_swap, bit = 4;
+        else if (key_len == 8 && memcmp(p, "SwapFree", 8) == 0)
+            value = &swap_free, bit = 8;
+
+        if (value != nullptr)
+        {
+            scanI64(colon + 1, end, *value);
+            found |= bit;
+        }
+        p = nextLine(colon, end);
+    }
+    mem.used_ram = mem.total_ram - available;
+    mem.used_swap = mem.total_swap - swap_free;
+    return found == 0xf;
+}
+
+/**
+ * Parses /proc/net/dev, one Net per interface line.
+ * The interface name may be directly followed by the first counter, as in "eth0:123".
+ *
+ * @param nets Cleared, then filled; its capacity is reused.
+ * @return The number of interfaces.
+ */
+size_t parseNetDev(const char *buf, size_t len, vector<Net> &nets)
+{
+    const char *p = buf, *end = buf + len;
+    nets.clear();
+    // skip the two header lines
+    p = nextLine(nextLine(p, end), end);
+
+    while (p < end)
+    {
+        p = skipSpaces(p, end);
+        const char *colon = p;
+        while (colon < end && *colon != ':' && *colon != '\n')
+            colon++;
+        if (colon == end || *colon != ':')
+        {
+            p = nextLine(p, end);
+            continue;
+        }
+
+        Net net;
+        size_t name_len = min((size_t)(colon - p), sizeof(net.name) - 1);
+        memcpy(net.name, p, name_len);
+        net.name[name_len] = '\0';
+
+        // the 16 counters, in the order of the RX and TX structs
+        unsigned long long *counters[] = {&net.received.bytes, &net.received.packets, &net.received.errs, &net.received.drop,
+                                          &net.received.fifo, &net.received.frame, &net.received.compressed, &net.received.multicast,
+                                          &net.transmited.bytes, &net.transmited.packets, &net.transmited.errs, &net.transmited.drop,
+                                          &net.transmited.fifo, &net.transmited.colls, &net.transmited.carrier, &net.transmited.compressed};
+        unsigned long long fields[16];
+        p = colon + 1;
+        size_t n = scanFields(p, end, fields, 16);
+        for (size_t i = 0; i < 16; i++)
+            *counters[i] = (i < n) ? fields[i] : 0;
+        nets.push_back(net);
+    }
+    return nets.size();
+}
+
+// Parses the first field of /proc/uptime, the seconds since boot.
+bool parseUptime(const char *buf, size_t len, double &uptime)
+{
+    const char *end = buf + len;
+    const char *p = scanDouble(buf, end, uptime);
+    return p != buf;
+}
+
+/**
+ * Parses /proc/[pid]/stat into the raw fields of a Proc.
+ * The name is the text between the first '(' and the last ')', so names
+ * containing spaces or parentheses do not shift the following fields.
+ *
+ * @return false if the line is malformed.
+ */
+bool parsePidStat(const char *buf, size_t len, Proc &proc)
+{
+    const char *p = buf, *end = buf + len;
+    long long pid;
+    p = scanI64(p, end, pid);
+    p = skipSpaces(p, end);
+    if (p == end || *p != '(')
+        return false;
+    const char *name = p + 1;
+    const char *close_paren = (const char *)memrchr(name, ')', end - name);
+    if (close_paren == nullptr || close_paren + 2 >= end)
+        return false;
+
+    proc.pid = pid;
+    size_t name_len = min((size_t)(close_paren - name), sizeof(proc.name) - 1);
+    memcpy(proc.name, name, name_len);
+    proc.name[name_len] = '\0';
+    proc.state = close_paren[2];
+
+    // fields are numbered from 1 as in proc(5), the state is field 3
+    // and fields[0] is field 4
+    unsigned long long fields[21];
+    p = close_paren + 3;
+    if (scanFields(p, end, fields, 21) < 21)
+        return false;
+    proc.utime = (long long)fields[14 - 4];
+    proc.stime = (long long)fields[15 - 4];
+    proc.cutime = (long long)fields[16 - 4];
+    proc.cstime = (long long)fields[17 - 4];
+    proc.starttime = fields[22 - 4];
+    proc.vsize = fields[23 - 4];
+    proc.rss = (long long)fields[24 - 4];
+    return true;
+}
@@ -0,0 +1,168 @@
+#include "header.h"
+
+// Self-overhead probes. Every probe feeds a histogram with a bounded relative
+// error, HDR style: values below HISTOGRAM_SUB_BUCKETS have a bucket each, and
+// every power of two above is split in HISTOGRAM_SUB_BUCKETS linear buckets,
+// so a quantile is off by at most 1/32 of its value. Recording is a few
+// relaxed atomic increments, the histograms are read from the UI thread.
+
+static const int HISTOGRAM_SUB_BITS = 5;
+static const int HISTOGRAM_SUB_BUCKETS = 1 << HISTOGRAM_SUB_BITS;
+static const int HISTOGRAM_BUCKETS = HISTOGRAM_SUB_BUCKETS * (64 - HISTOGRAM_SUB_BITS + 1);
+
+struct Histogram
+{
+    atomic<unsigned long long> counts[HISTOGRAM_BUCKETS];
+    atomic<unsigned long long> total;
+    atomic<unsigned long long> max;
+};
+
+static Histogram histograms[PROBE_COUNT];
+
+// names of the probes after the collectors
+static const char *const probe_names[PROBE_COUNT - COLLECTOR_COUNT] = {
+    "publish", "systemWindow", "memoryProcessesWindow", "networkWindow", "frame",
+    "syscalls/sample", "allocations/sample", "allocations/frame",
+};
+
+// allocations through operator new, in the whole process and on the calling thread
+static atomic<unsigned long long> allocation_count(0);
+static thread_local unsigned long long thread_allocation_count = 0;
+
+static int histogramBucket(unsigned long long value)
+{
+    if (value < (unsigned long long)HISTOGRAM_SUB_BUCKETS)
+        return value;
+    int power = 63 - __builtin_clzll(value);
+    int sub = (value >> (power - HISTOGRAM_SUB_BITS)) - HISTOGRAM_SUB_BUCKETS;
+    return HISTOGRAM_SUB_BUCKETS * (power - HISTOGRAM_SUB_BITS + 1) + sub;
+}
+
+// Middle of the values falling in a bucket.
+static unsigned long long histogramValue(int bucket)
+{
+    if (bucket < HISTOGRAM_SUB_BUCKETS)
+        return bucket;
+    int power = bucket / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BITS - 1;
+    unsigned long long sub = bucket % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS;
+    unsigned long long width = 1ULL << (power - HISTOGRAM_SUB_BITS);
+    return sub * width + width / 2;
+}
+
+/**
+ * Adds a value to a probe.
+ *
+ * @param probe A collector index or a ProbeId.
+ * @param value Nanoseconds for the timing probes, a count for the others.
+ */
+void recordProbe(int probe, unsigned long long value)
+{
+    Histogram &h = histograms[probe];
+    h.counts[histogramBucket(value)].fetch_add(1, memory_order_relaxed);
+    h.total.fetch_add(1, memory_order_relaxed);
+    unsigned long long prev = h.max.load(memory_order_relaxed);
+    while (value > prev && !h.max.compare_exchange_weak(prev, value, memory_order_relaxed))
+        ;
+}
+
+const char *probeName(int probe)
+{
+    return probe < COLLECTOR_COUNT ? collectors[probe].name : probe_names[probe - COLLECTOR_COUNT];
+}
+
+// Timing probes are in nanoseconds, the others count syscalls or allocations.
+bool probeIsTiming(int probe)
+{
+    return probe <= PROBE_FRAME;
+}
+
+/**
+ * Summarizes a probe since the start of the monitor.
+ * Concurrent recordings may be missed or counted half, the quantiles stay within a bucket.
+ */
+ProbeSummary summarizeProbe(int probe)
+{
+    const Histogram &h = histograms[probe];
+    ProbeSummary summary = {};
+    summary.count = h.total.load(memory_order_relaxed);
+    summary.max = h.max.load(memory_order_relaxed);
+    if (summary.count == 0)
+        return summary;
+
+    unsigned long long p50_rank = (summary.count + 1) / 2;
+    unsigned long long p99_rank = summary.count - summary.count / 100;
+    unsigned long long seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS && seen < p99_rank; i++)
+    {
+        unsigned long long count = h.counts[i].load(memory_order_relaxed);
+        if (count == 0)
+            continue;
+        if (seen < p50_rank && seen + count >= p50_rank)
+            summary.p50 = histogramValue(i);
+        seen += count;
+        if (seen >= p99_rank)
+            summary.p99 = histogramValue(i);
+    }
+    summary.p50 = min(summary.p50, summary.max);
+    summary.p99 = min(summary.p99, summary.max);
+    return summary;
+}
+
+// Number of operator new calls so far, in the whole process.
+unsigned long long allocationCount()
+{
+    return allocation_count.load(memory_order_relaxed);
+}
+
+// Number of operator new calls so far, on the calling thread only.
+unsigned long long threadAllocationCount()
+{
+    return thread_allocation_count;
+}
+
+/**
+ * Reads the resident set size of the monitor from /proc/self/statm.
+ *
+ * @return The RSS in KiB, 0 if it cannot be read.
+ */
+long long getMonitorRSS()
+{
+    static ProcFile statm_file = {"/proc/self/statm", -1};
+    static const long page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    if (!readProcFile(statm_file))
+        return 0;
+    const char *p = statm_file.buf.data();
+    const char *end = p + statm_file.len;
+    unsigned long long size, resident;
+    p = scanU64(p, end, size);
+    scanU64(p, end, resident);
+    return resident * page_kb;
+}
+
+// Counting replacements of the global allocation functions. new[] and the
+// nothrow forms call these, the aligned forms are left to the library.
+void *operator new(size_t size)
+{
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    thread_allocation_count++;
+    void *p;
+    // as the standard requires, the installed new_handler gets a chance to free memory before bad_alloc
+    while ((p = malloc(size ? size : 1)) == nullptr)
+    {
+        new_handler handler = get_new_handler();
+        if (handler == nullptr)
+            throw bad_alloc();
+        handler();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
@@ -0,0 +1,298 @@
+#include "header.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+// Process events from the kernel proc connector (NETLINK_CONNECTOR, needs CAP_NET_ADMIN).
+// A listener thread keeps the set of live pids up to date from the fork and
+// exit events, so the process scan does not have to list /proc on every sample,
+// and records the processes that exited together with their final CPU time.
+// When the socket cannot be set up, the scan keeps listing /proc.
+
+// exited processes kept for the UI
+static const size_t EXITED_MAX = 100;
+
+static thread events_thread;
+static int events_socket = -1;
+static int events_stop_fd = -1;
+
+// shared between the listener and the sampler thread
+static mutex events_mutex;
+static set<int> live_pids;
+static bool events_resync = true; // live_pids must be rebuilt from /proc, at start and after lost events
+static unsigned long long fork_total = 0;
+static unsigned long long exec_total = 0;
+static unsigned long long exit_total = 0;
+static vector<ExitedProc> exited; // oldest first, at most EXITED_MAX
+
+// sampler thread only, for the rates
+static unsigned long long last_forks, last_execs, last_exits;
+static long long last_rates_ns = 0;
+
+// Sends PROC_CN_MCAST_LISTEN or PROC_CN_MCAST_IGNORE to the connector.
+static bool sendProcEventsOp(enum proc_cn_mcast_op op)
+{
+    alignas(struct nlmsghdr) char request[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(op))];
+    memset(request, 0, sizeof(request));
+    struct nlmsghdr *header = (struct nlmsghdr *)request;
+    header->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+    header->nlmsg_type = NLMSG_DONE;
+    header->nlmsg_pid = getpid();
+    struct cn_msg *msg = (struct cn_msg *)NLMSG_DATA(header);
+    msg->id.idx = CN_IDX_PROC;
+    msg->id.val = CN_VAL_PROC;
+    msg->len = sizeof(op);
+    memcpy(msg->data, &op, sizeof(op));
+    return send(events_socket, request, header->nlmsg_len, 0) == (ssize_t)header->nlmsg_len;
+}
+
+/**
+ * Reads the name and CPU time of a process that is exiting.
+ * The exit event is sent before the parent reaps the process, so its stat
+ * file can usually still be read. The syscalls are not counted in
+ * syscall_count, they are not part of any collector.
+ */
+static void readExitedStat(int proc_fd, ExitedProc &proc)
+{
+    char path[32];
+    char buf[1024];
+    snprintf(path, sizeof(path), "%d/stat", proc.pid);
+    int fd = openat(proc_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    Proc stat;
+    if (n > 0 && parsePidStat(buf, n, stat))
+    {
+        static const double hertz = sysconf(_SC_CLK_TCK);
+        memcpy(proc.name, stat.name, sizeof(proc.name));
+        proc.cpu_seconds = (stat.utime + stat.stime) / hertz;
+    }
+}
+
+// Applies one event to the pid set and the counters.
+static void handleProcEvent(const struct proc_event &event, int proc_fd)
+{
+    switch (event.what)
+    {
+    case proc_event::PROC_EVENT_FORK:
+    {
+        // threads share the tgid of their process and are not tracked
+        if (event.event_data.fork.child_pid != event.event_data.fork.child_tgid)
+            return;
+        lock_guard<mutex> lock(events_mutex);
+        live_pids.insert(event.event_data.fork.child_tgid);
+        fork_total++;
+        break;
+    }
+    case proc_event::PROC_EVENT_EXEC:
+    {
+        lock_guard<mutex> lock(events_mutex);
+        exec_total++;
+        break;
+    }
+    case proc_event::PROC_EVENT_EXIT:
+    {
+        if (event.event_data.exit.process_pid != event.event_data.exit.process_tgid)
+            return;
+        ExitedProc proc = {};
+        proc.pid = event.event_data.exit.process_tgid;
+        proc.exit_code = event.event_data.exit.exit_code;
+        proc.cpu_seconds = -1;
+        proc.time = time(nullptr);
+        readExitedStat(proc_fd, proc);
+
+        lock_guard<mutex> lock(events_mutex);
+        live_pids.erase(proc.pid);
+        exit_total++;
+        if (exited.size() == EXITED_MAX)
+            exited.erase(exited.begin());
+        exited.push_back(proc);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Listener thread body, reads the connector socket until stopProcEvents() is called.
+static void procEventsLoop()
+{
+    int proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    alignas(struct nlmsghdr) char buf[16384];
+    struct pollfd fds[2] = {{events_socket, POLLIN, 0}, {events_stop_fd, POLLIN, 0}};
+    for (;;)
+    {
+        if (poll(fds, 2, -1) < 0 && errno != EINTR)
+            break;
+        if (fds[1].revents & POLLIN)
+            break;
+        if (!(fds[0].revents & POLLIN))
+            continue;
+
+        ssize_t n = recv(events_socket, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n < 0)
+        {
+            // the socket buffer overflowed, some events are lost
+            if (errno == ENOBUFS)
+            {
+                lock_guard<mutex> lock(events_mutex);
+                events_resync = true;
+            }
+            continue;
+        }
+        for (struct nlmsghdr *header = (struct nlmsghdr *)buf; NLMSG_OK(header, n); header = NLMSG_NEXT(header, n))
+        {
+            if (header->nlmsg_type != NLMSG_DONE)
+                continue;
+            const struct cn_msg *msg = (const struct cn_msg *)NLMSG_DATA(header);
+            if (msg->id.idx != CN_IDX_PROC || msg->id.val != CN_VAL_PROC)
+                continue;
+            handleProcEvent(*(const struct proc_event *)msg->data, proc_fd);
+        }
+    }
+    if (proc_fd >= 0)
+        close(proc_fd);
+}
+
+/**
+ * Subscribes to the process events and starts the listener thread.
+ *
+ * @return false if the proc connector is not available, e.g. without CAP_NET_ADMIN.
+ */
+bool startProcEvents()
+{
+    if (events_thread.joinable())
+        return true;
+    events_socket = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (events_socket < 0)
+        return false;
+
+    // bursts of thousands of short-lived processes must fit between two wake-ups
+    int rcvbuf = 4 << 20;
+    setsockopt(events_socket, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    addr.nl_pid = 0;
+    events_stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (bind(events_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0 || events_stop_fd < 0 ||
+        !sendProcEventsOp(PROC_CN_MCAST_LISTEN))
+    {
+        close(events_socket);
+        events_socket = -1;
+        if (events_stop_fd >= 0)
+            close(events_stop_fd);
+        events_stop_fd = -1;
+        return false;
+    }
+    events_resync = true;
+    events_thread = thread(procEventsLoop);
+    return true;
+}
+
+void stopProcEvents()
+{
+    if (!events_thread.joinable())
+        return;
+    uint64_t one = 1;
+    if (write(events_stop_fd, &one, sizeof(one)) < 0)
+        perror("proc events");
+    events_thread.join();
+    sendProcEventsOp(PROC_CN_MCAST_IGNORE);
+    close(events_socket);
+    close(events_stop_fd);
+    events_socket = events_stop_fd = -1;
+}
+
+/**
+ * Gives the live pids known from the events, in increasing order.
+ * The set is rebuilt from /proc first when it is not trustworthy: on the
+ * first call and after the socket dropped events.
+ *
+ * @return false if the events are not available, pids is then left untouched.
+ */
+bool getProcEventPids(vector<int> &pids)
+{
+    if (!events_thread.joinable())
+        return false;
+
+    unique_lock<mutex> lock(events_mutex);
+    if (events_resync)
+    {
+        events_resync = false;
+        live_pids.clear();
+        // events received while listing are applied to the set as usual,
+        // a pid that exits in between is removed by forgetProcEventPids()
+        lock.unlock();
+        listPids(procDirFd(), pids);
+        lock.lock();
+        live_pids.insert(pids.begin(), pids.end());
+    }
+    pids.assign(live_pids.begin(), live_pids.end());
+    return true;
+}
+
+// Removes pids whose stat file could not be read, their exit event was missed.
+void forgetProcEventPids(const vector<int> &pids)
+{
+    if (pids.empty())
+        return;
+    lock_guard<mutex> lock(events_mutex);
+    for (int pid : pids)
+        live_pids.erase(pid);
+}
+
+/**
+ * Fills the process event statistics of a snapshot.
+ *
+ * @param events Receives the rates since the previous call and the recently exited processes, newest first.
+ * @param processes The previous process table, sorted by pid, gives the last known name and
+ *                  CPU time of exited processes whose stat file was already gone.
+ */
+void getProcEvents(ProcEvents &events, const vector<Proc> &processes)
+{
+    events.active = events_thread.joinable();
+    if (!events.active)
+        return;
+
+    static const double hertz = sysconf(_SC_CLK_TCK);
+    {
+        lock_guard<mutex> lock(events_mutex);
+        for (ExitedProc &proc : exited)
+        {
+            if (proc.cpu_seconds >= 0)
+                continue;
+            auto it = lower_bound(processes.begin(), processes.end(), proc.pid, [](const Proc &p, int pid) { return p.pid < pid; });
+            if (it != processes.end() && it->pid == proc.pid)
+            {
+                memcpy(proc.name, it->name, sizeof(proc.name));
+                proc.cpu_seconds = (it->utime + it->stime) / hertz;
+            }
+        }
+        events.forks = fork_total;
+        events.execs = exec_total;
+        events.exits = exit_total;
+        events.exited.assign(exited.rbegin(), exited.rend());
+    }
+
+    long long now = monotonicNs();
+    if (last_rates_ns != 0)
+    {
+        float seconds = (now - last_rates_ns) / 1e9f;
+        events.fork_rate = (events.forks - last_forks) / seconds;
+        events.exec_rate = (events.execs - last_execs) / seconds;
+        events.exit_rate = (events.exits - last_exits) / seconds;
+    }
+    last_rates_ns = now;
+    last_forks = events.forks;
+    last_execs = events.execs;
+    last_exits = events.exits;
+}
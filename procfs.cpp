@@ -0,0 +1,309 @@
+#include "header.h"
+#include <fcntl.h>
+#include <sys/syscall.h>
+
+// Every open/read/close done through this file, used for the syscalls per sample statistics.
+atomic<unsigned long long> syscall_count(0);
+
+// a file that could not be opened is tried again after this delay
+static const long long REOPEN_DELAY_NS = 30 * 1000000000LL;
+
+// bumped by setFileRoots(), the kept-open descriptors of an older generation are reopened
+static unsigned roots_generation = 0;
+
+// Adds syscalls done outside of this file (statvfs, uname...) to syscall_count.
+void countSyscalls(unsigned long long n)
+{
+    syscall_count.fetch_add(n, memory_order_relaxed);
+}
+
+/**
+ * Moves the /proc and /sys trees read through this file, and by the process
+ * scan, to other directories, like the synthetic trees of synthetic.cpp.
+ * The kept-open files are reopened under the new roots on their next read.
+ * Must not run while a collector does: before the sampler starts, or between benchmarks.
+ */
+void setFileRoots(const char *proc_root, const char *sys_root)
+{
+    monitor_config.proc_root = proc_root;
+    monitor_config.sys_root = sys_root;
+    roots_generation++;
+}
+
+// true when the roots are the machine's /proc and /sys
+bool liveFileRoots()
+{
+    return strcmp(monitor_config.proc_root, "/proc") == 0 && strcmp(monitor_config.sys_root, "/sys") == 0;
+}
+
+// Length of prefix when path is prefix itself or a path below it, 0 otherwise.
+static size_t underDir(const char *path, const char *prefix)
+{
+    size_t len = strlen(prefix);
+    return strncmp(path, prefix, len) == 0 && (path[len] == '/' || path[len] == '\0') ? len : 0;
+}
+
+/**
+ * Gives where a /proc or /sys path is under the configured roots.
+ * /proc/self and /proc/thread-self stay the monitor's own.
+ *
+ * @param path An absolute path.
+ * @param out Receives the rooted path when it is not path itself.
+ * @return path, or out.
+ */
+const char *rootedPath(const char *path, char *out, size_t size)
+{
+    size_t len;
+    const char *root;
+    if ((len = underDir(path, "/proc")) != 0)
+    {
+        if (underDir(path, "/proc/self") || underDir(path, "/proc/thread-self"))
+            return path;
+        root = monitor_config.proc_root;
+    }
+    else if ((len = underDir(path, "/sys")) != 0)
+        root = monitor_config.sys_root;
+    else
+        return path;
+    if (strncmp(root, path, len) == 0 && root[len] == '\0')
+        return path;
+    snprintf(out, size, "%s%s", root, path + len);
+    return out;
+}
+
+// The reverse of rootedPath(), so captures always record /proc and /sys paths.
+string unrootedPath(const char *path)
+{
+    size_t len;
+    if (!liveFileRoots() && (len = underDir(path, monitor_config.proc_root)) != 0)
+        return string("/proc") + (path + len);
+    if (!liveFileRoots() && (len = underDir(path, monitor_config.sys_root)) != 0)
+        return string("/sys") + (path + len);
+    return path;
+}
+
+/**
+ * Reads a /proc or /sys file through its kept-open descriptor.
+ * The file is opened on the first call, then re-read with pread() from offset 0,
+ * which makes the kernel generate its content again. A seq_file hands out about
+ * a page per read, so the file is read until pread() returns 0. The buffer grows
+ * until the whole file fits, and is reused from one call to the next.
+ *
+ * @param file The file to read, its buf holds the content followed by a '\0'.
+ * @return true if the file could be read.
+ */
+static bool readProcFileDirect(ProcFile &file)
+{
+    file.len = 0;
+    if (file.fd >= 0 && file.generation != roots_generation)
+    {
+        countSyscalls(1);
+        close(file.fd);
+        file.fd = -1;
+    }
+    if (file.fd < 0)
+    {
+        long long now = monotonicNs();
+        if (file.failed_at != 0 && now - file.failed_at < REOPEN_DELAY_NS)
+            return false;
+        char path[PATH_MAX];
+        countSyscalls(1);
+        file.fd = open(rootedPath(file.path, path, sizeof(path)), O_RDONLY | O_CLOEXEC);
+        if (file.fd < 0)
+        {
+            file.failed_at = now;
+            return false;
+        }
+        file.failed_at = 0;
+        file.generation = roots_generation;
+    }
+    if (file.buf.size() < 4096)
+        file.buf.resize(4096);
+
+    size_t len = 0;
+    for (;;)
+    {
+        if (len == file.buf.size() - 1)
+            file.buf.resize(file.buf.size() * 2);
+        countSyscalls(1);
+        ssize_t n = pread(file.fd, file.buf.data() + len, file.buf.size() - 1 - len, len);
+        if (n < 0)
+        {
+            countSyscalls(1);
+            close(file.fd);
+            file.fd = -1;
+            file.failed_at = monotonicNs();
+            return false;
+        }
+        if (n == 0)
+            break;
+        len += n;
+    }
+    file.len = len;
+    file.buf[len] = '\0';
+    return true;
+}
+
+// Copies a replayed file into buf followed by a '\0', at most size - 1 bytes.
+static ssize_t copyReplayed(const string *content, char *buf, size_t size)
+{
+    if (content == nullptr)
+        return -1;
+    size_t n = min(content->size(), size - 1);
+    memcpy(buf, content->data(), n);
+    buf[n] = '\0';
+    return n;
+}
+
+// readProcFileDirect(), or the content of a capture when one is replayed.
+bool readProcFile(ProcFile &file)
+{
+    const string *content;
+    if (replayFile(file.path, content))
+    {
+        file.len = 0;
+        if (content == nullptr)
+            return false;
+        if (file.buf.size() <= content->size())
+            file.buf.resize(content->size() + 1);
+        file.len = copyReplayed(content, file.buf.data(), file.buf.size());
+        return true;
+    }
+    bool ok = readProcFileDirect(file);
+    if (capturing())
+        captureFile(file.path, ok ? file.buf.data() : nullptr, file.len);
+    return ok;
+}
+
+/**
+ * Reads a whole small file with open/read/close, for files that are only read
+ * once, like /proc/[pid]/stat.
+ *
+ * @param path The path of the file.
+ * @param buf The buffer receiving the content followed by a '\0'.
+ * @param size The size of buf.
+ * @return The number of bytes read, or -1 if the file could not be read.
+ */
+ssize_t readSmallFile(const char *path, char *buf, size_t size)
+{
+    const string *content;
+    if (replayFile(path, content))
+        return copyReplayed(content, buf, size);
+
+    char rooted[PATH_MAX];
+    countSyscalls(1);
+    int fd = open(rootedPath(path, rooted, sizeof(rooted)), O_RDONLY | O_CLOEXEC);
+    ssize_t n = -1;
+    if (fd >= 0)
+    {
+        countSyscalls(2);
+        n = read(fd, buf, size - 1);
+        close(fd);
+    }
+    if (n >= 0)
+        buf[n] = '\0';
+    if (capturing())
+        captureFile(path, n >= 0 ? buf : nullptr, max(n, (ssize_t)0));
+    return n >= 0 ? n : -1;
+}
+
+// Same as readSmallFile(), with path relative to the directory dir_fd.
+ssize_t readSmallFileAt(int dir_fd, const char *path, char *buf, size_t size)
+{
+    char full_path[PATH_MAX];
+    if (capturing() || replaying())
+        snprintf(full_path, sizeof(full_path), "%s/%s", fixtureDirPath(dir_fd), path);
+    const string *content;
+    if (replaying() && replayFile(full_path, content))
+        return copyReplayed(content, buf, size);
+
+    countSyscalls(1);
+    int fd = openat(dir_fd, path, O_RDONLY | O_CLOEXEC);
+    ssize_t n = -1;
+    if (fd >= 0)
+    {
+        countSyscalls(2);
+        n = read(fd, buf, size - 1);
+        close(fd);
+    }
+    if (n >= 0)
+        buf[n] = '\0';
+    if (capturing())
+        captureFile(full_path, n >= 0 ? buf : nullptr, max(n, (ssize_t)0));
+    return n >= 0 ? n : -1;
+}
+
+// Opens the /proc directory under the configured root.
+int openProcDir()
+{
+    char path[PATH_MAX];
+    countSyscalls(1);
+    return open(rootedPath("/proc", path, sizeof(path)), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+// Descriptor on /proc kept open for listPids(), opened on the first call and after setFileRoots().
+int procDirFd()
+{
+    static int fd = -1;
+    static unsigned generation = 0;
+    if (fd >= 0 && generation != roots_generation)
+    {
+        countSyscalls(1);
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0)
+    {
+        fd = openProcDir();
+        generation = roots_generation;
+    }
+    return fd;
+}
+
+/**
+ * Lists the numeric entries of a directory with getdents64, like the pids
+ * of /proc or the thread ids of /proc/[pid]/task. The directory is rewound
+ * first, so the same descriptor can be listed again on every sample.
+ * Nothing is allocated per entry and no entry is stat'ed.
+ *
+ * @param dir_fd A directory opened with O_DIRECTORY.
+ * @param ids Receives the ids, in directory order. Its capacity is reused.
+ * @return The number of ids found.
+ */
+size_t listPids(int dir_fd, vector<int> &ids)
+{
+    alignas(8) char buf[32768];
+    ids.clear();
+    if (dir_fd < 0)
+        return 0;
+    if (replaying() && replayDir(fixtureDirPath(dir_fd), ids))
+        return ids.size();
+    countSyscalls(1);
+    if (lseek(dir_fd, 0, SEEK_SET) < 0)
+        return 0;
+    for (;;)
+    {
+        countSyscalls(1);
+        long n = syscall(SYS_getdents64, dir_fd, buf, sizeof(buf));
+        if (n <= 0)
+            break;
+        for (long offset = 0; offset < n;)
+        {
+            const struct dirent64 *entry = (const struct dirent64 *)(buf + offset);
+            offset += entry->d_reclen;
+            if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN)
+                continue;
+            const char *name = entry->d_name;
+            if (*name < '1' || *name > '9')
+                continue;
+            int id = 0;
+            while (*name >= '0' && *name <= '9')
+                id = id * 10 + (*name++ - '0');
+            if (*name == '\0')
+                ids.push_back(id);
+        }
+    }
+    if (capturing())
+        captureDir(fixtureDirPath(dir_fd), ids);
+    return ids.size();
+}
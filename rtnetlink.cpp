@@ -0,0 +1,534 @@
+#include "header.h"
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+#include <linux/if_addr.h>
+#include <stdarg.h>
+
+// Interface statistics from the kernel routing socket (NETLINK_ROUTE).
+// A single RTM_GETSTATS dump returns the 64-bit counters of every interface,
+// where /proc/net/dev has to be generated as text and parsed back.
+// RTM_GETSTATS only gives interface indexes, the names come from an
+// RTM_GETLINK dump that is only repeated when an unknown index shows up or
+// the names are old. Kernels without RTM_GETSTATS (before 4.7) get the
+// counters from IFLA_STATS64 in the RTM_GETLINK dump of every sample.
+
+// interface names are dumped again after this delay, to notice renames
+static const long long LINK_NAMES_MAX_AGE_NS = 30 * 1000000000LL;
+
+static int rtnl_socket = -1;
+static bool rtnl_failed = false;  // the socket could not be used, stay on /proc/net/dev
+static bool getstats_failed = false; // RTM_GETSTATS is not supported, use RTM_GETLINK
+static unsigned rtnl_seq = 0;
+static vector<char> rtnl_buf;
+
+struct LinkName
+{
+    char name[IFNAMSIZ];
+};
+static map<int, LinkName> link_names; // by interface index
+static long long link_names_ns = 0;
+static vector<int> stats_indexes; // index of every entry of the last RTM_GETSTATS dump
+
+// Opens the routing socket on the first call.
+static bool openRtnl()
+{
+    if (rtnl_socket >= 0)
+        return true;
+    if (rtnl_failed)
+        return false;
+    countSyscalls(2);
+    rtnl_socket = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    if (rtnl_socket < 0 || bind(rtnl_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        if (rtnl_socket >= 0)
+            close(rtnl_socket);
+        rtnl_socket = -1;
+        rtnl_failed = true;
+        return false;
+    }
+    // big enough for a dump part of any size the kernel sends
+    rtnl_buf.resize(64 * 1024);
+    return true;
+}
+
+/**
+ * Sends a dump request and calls on_message for every message of the reply.
+ *
+ * @param type The request, like RTM_GETLINK.
+ * @param body The family specific header of the request.
+ * @param body_len The size of body.
+ * @return false if the request failed or the kernel answered with an error.
+ */
+template <typename F>
+static bool rtnlDump(unsigned short type, const void *body, size_t body_len, F on_message)
+{
+    alignas(struct nlmsghdr) char request[NLMSG_SPACE(64)];
+    memset(request, 0, sizeof(request));
+    struct nlmsghdr *header = (struct nlmsghdr *)request;
+    header->nlmsg_len = NLMSG_LENGTH(body_len);
+    header->nlmsg_type = type;
+    header->nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    header->nlmsg_seq = ++rtnl_seq;
+    memcpy(NLMSG_DATA(header), body, body_len);
+
+    countSyscalls(1);
+    if (send(rtnl_socket, request, header->nlmsg_len, 0) < 0)
+        return false;
+
+    for (;;)
+    {
+        countSyscalls(1);
+        ssize_t n = recv(rtnl_socket, rtnl_buf.data(), rtnl_buf.size(), 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        int len = n;
+        for (struct nlmsghdr *reply = (struct nlmsghdr *)rtnl_buf.data(); NLMSG_OK(reply, len); reply = NLMSG_NEXT(reply, len))
+        {
+            // replies to an earlier dump that was given up
+            if (reply->nlmsg_seq != rtnl_seq)
+                continue;
+            if (reply->nlmsg_type == NLMSG_DONE)
+                return true;
+            if (reply->nlmsg_type == NLMSG_ERROR)
+                return false;
+            on_message(reply);
+        }
+    }
+}
+
+// Copies rtnl_link_stats64 into the counters of a Net, with the same sums as the kernel does for /proc/net/dev.
+static void setLinkCounters(const struct rtnl_link_stats64 &stats, Net &net)
+{
+    net.received.bytes = stats.rx_bytes;
+    net.received.packets = stats.rx_packets;
+    net.received.errs = stats.rx_errors;
+    net.received.drop = stats.rx_dropped + stats.rx_missed_errors;
+    net.received.fifo = stats.rx_fifo_errors;
+    net.received.frame = stats.rx_length_errors + stats.rx_over_errors + stats.rx_crc_errors + stats.rx_frame_errors;
+    net.received.compressed = stats.rx_compressed;
+    net.received.multicast = stats.multicast;
+    net.transmited.bytes = stats.tx_bytes;
+    net.transmited.packets = stats.tx_packets;
+    net.transmited.errs = stats.tx_errors;
+    net.transmited.drop = stats.tx_dropped;
+    net.transmited.fifo = stats.tx_fifo_errors;
+    net.transmited.colls = stats.collisions;
+    net.transmited.carrier = stats.tx_carrier_errors + stats.tx_aborted_errors + stats.tx_window_errors + stats.tx_heartbeat_errors;
+    net.transmited.compressed = stats.tx_compressed;
+}
+
+/**
+ * Reads the name, and the counters when stats is not null, of an RTM_NEWLINK message.
+ *
+ * @return false if the message lacks one of them.
+ */
+static bool parseLinkMessage(const struct nlmsghdr *header, char *name, struct rtnl_link_stats64 *stats)
+{
+    const struct ifinfomsg *info = (const struct ifinfomsg *)NLMSG_DATA(header);
+    int len = header->nlmsg_len - NLMSG_LENGTH(sizeof(*info));
+    bool has_name = false, has_stats = false;
+    for (const struct rtattr *attr = IFLA_RTA(info); RTA_OK(attr, len); attr = RTA_NEXT(attr, len))
+    {
+        if (attr->rta_type == IFLA_IFNAME)
+        {
+            snprintf(name, IFNAMSIZ, "%s", (const char *)RTA_DATA(attr));
+            has_name = true;
+        }
+        else if (stats != nullptr && attr->rta_type == IFLA_STATS64 && RTA_PAYLOAD(attr) >= sizeof(*stats))
+        {
+            // attributes are only 4-byte aligned
+            memcpy(stats, RTA_DATA(attr), sizeof(*stats));
+            has_stats = true;
+        }
+    }
+    return has_name && (stats == nullptr || has_stats);
+}
+
+// Dumps every link, to fill link_names, and nets when it is not null.
+static bool dumpLinks(vector<Net> *nets)
+{
+    struct ifinfomsg info;
+    memset(&info, 0, sizeof(info));
+    info.ifi_family = AF_UNSPEC;
+    link_names.clear();
+    link_names_ns = monotonicNs();
+    return rtnlDump(RTM_GETLINK, &info, sizeof(info), [&](const struct nlmsghdr *reply) {
+        if (reply->nlmsg_type != RTM_NEWLINK)
+            return;
+        int index = ((const struct ifinfomsg *)NLMSG_DATA(reply))->ifi_index;
+        Net net;
+        struct rtnl_link_stats64 stats;
+        if (!parseLinkMessage(reply, net.name, nets ? &stats : nullptr))
+            return;
+        memcpy(link_names[index].name, net.name, IFNAMSIZ);
+        if (nets != nullptr)
+        {
+            setLinkCounters(stats, net);
+            nets->push_back(net);
+        }
+    });
+}
+
+// Fills nets from an RTM_GETSTATS dump, the names are set by nameStats().
+static bool dumpStats(vector<Net> &nets)
+{
+    struct if_stats_msg request;
+    memset(&request, 0, sizeof(request));
+    request.family = AF_UNSPEC;
+    request.filter_mask = IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64);
+    stats_indexes.clear();
+    return rtnlDump(RTM_GETSTATS, &request, sizeof(request), [&](const struct nlmsghdr *reply) {
+        if (reply->nlmsg_type != RTM_NEWSTATS)
+            return;
+        const struct if_stats_msg *msg = (const struct if_stats_msg *)NLMSG_DATA(reply);
+        int len = reply->nlmsg_len - NLMSG_LENGTH(NLMSG_ALIGN(sizeof(*msg)));
+        const struct rtattr *attr = (const struct rtattr *)((const char *)msg + NLMSG_ALIGN(sizeof(*msg)));
+        for (; RTA_OK(attr, len); attr = RTA_NEXT(attr, len))
+        {
+            if (attr->rta_type != IFLA_STATS_LINK_64 || RTA_PAYLOAD(attr) < sizeof(struct rtnl_link_stats64))
+                continue;
+            struct rtnl_link_stats64 stats;
+            memcpy(&stats, RTA_DATA(attr), sizeof(stats));
+            Net net;
+            net.name[0] = '\0';
+            setLinkCounters(stats, net);
+            nets.push_back(net);
+            stats_indexes.push_back(msg->ifindex);
+        }
+    });
+}
+
+// Whether every interface of the last dumpStats() is in link_names.
+static bool statsNamesKnown()
+{
+    for (int index : stats_indexes)
+    {
+        if (link_names.find(index) == link_names.end())
+            return false;
+    }
+    return true;
+}
+
+// Names the entries of the last dumpStats(), entries without a known name are removed.
+static void nameStats(vector<Net> &nets)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < nets.size(); i++)
+    {
+        auto it = link_names.find(stats_indexes[i]);
+        if (it == link_names.end())
+            continue;
+        memcpy(nets[i].name, it->second.name, IFNAMSIZ);
+        nets[kept++] = nets[i];
+    }
+    nets.resize(kept);
+}
+
+/**
+ * Fills nets with the counters of every interface from rtnetlink.
+ *
+ * @param nets Cleared first, its capacity is reused from one sample to the next.
+ * @return false if rtnetlink is not available, the caller then reads /proc/net/dev.
+ */
+bool getLinkStats(vector<Net> &nets)
+{
+    nets.clear();
+    if (!openRtnl())
+        return false;
+
+    if (!getstats_failed)
+    {
+        if (monotonicNs() - link_names_ns > LINK_NAMES_MAX_AGE_NS)
+            dumpLinks(nullptr);
+        if (dumpStats(nets))
+        {
+            // a new interface showed up
+            if (!statsNamesKnown())
+                dumpLinks(nullptr);
+            nameStats(nets);
+            return true;
+        }
+        getstats_failed = true;
+        nets.clear();
+    }
+    return dumpLinks(&nets);
+}
+
+// Interfaces and addresses, kept up to date from the RTMGRP_LINK and
+// RTMGRP_IPV4/IPV6_IFADDR notifications. The table is dumped once, after
+// subscribing, and then only changes when a notification arrives.
+
+// from linux/if.h, which clashes with net/if.h
+#ifndef IFF_LOWER_UP
+#define IFF_LOWER_UP 0x10000
+#endif
+
+// entries kept in the event log
+static const size_t LINK_EVENTS_MAX = 200;
+
+static int link_events_socket = -1;
+static bool link_events_failed = false;
+// A table dumped in an older generation, or never, is dumped again: every
+// table once, and all of them after notifications were lost. The tables live
+// in the snapshots, any of which the collector may be given.
+static unsigned link_dump_generation = 1;
+
+/**
+ * Opens the notification socket on the first call.
+ * The sampler polls it, and runs the addresses collector when it becomes readable.
+ *
+ * @return The socket, or -1 if rtnetlink is not available.
+ */
+int linkEventsFd()
+{
+    if (link_events_socket >= 0 || link_events_failed)
+        return link_events_socket;
+    countSyscalls(3);
+    link_events_socket = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    int on = 1;
+    if (link_events_socket < 0 || bind(link_events_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        setsockopt(link_events_socket, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0)
+    {
+        if (link_events_socket >= 0)
+            close(link_events_socket);
+        link_events_socket = -1;
+        link_events_failed = true;
+    }
+    return link_events_socket;
+}
+
+static void logLinkEvent(Networks *networks, const struct timespec &time, const char *format, ...)
+{
+    LinkEvent event;
+    event.time = time;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(event.text, sizeof(event.text), format, args);
+    va_end(args);
+    if (networks->events.size() == LINK_EVENTS_MAX)
+        networks->events.erase(networks->events.begin());
+    networks->events.push_back(event);
+}
+
+static Link *findLink(Networks *networks, int index)
+{
+    for (Link &link : networks->links)
+    {
+        if (link.index == index)
+            return &link;
+    }
+    return nullptr;
+}
+
+/**
+ * Applies an RTM_NEWLINK or RTM_DELLINK message to the table.
+ *
+ * @param time The arrival time for the event log, or null while dumping the table.
+ */
+static void applyLinkMessage(Networks *networks, const struct nlmsghdr *header, const struct timespec *time)
+{
+    const struct ifinfomsg *info = (const struct ifinfomsg *)NLMSG_DATA(header);
+    Link *link = findLink(networks, info->ifi_index);
+    if (header->nlmsg_type == RTM_DELLINK)
+    {
+        if (link == nullptr)
+            return;
+        if (time)
+            logLinkEvent(networks, *time, "%s removed", link->name);
+        networks->links.erase(networks->links.begin() + (link - networks->links.data()));
+        return;
+    }
+
+    char name[IFNAMSIZ];
+    if (!parseLinkMessage(header, name, nullptr))
+        return;
+    bool up = info->ifi_flags & IFF_UP;
+    bool carrier = info->ifi_flags & IFF_LOWER_UP;
+    if (link == nullptr)
+    {
+        networks->links.push_back(Link());
+        link = &networks->links.back();
+        link->index = info->ifi_index;
+        memcpy(link->name, name, IFNAMSIZ);
+        if (time)
+            logLinkEvent(networks, *time, "%s added, %s", name, up ? "up" : "down");
+    }
+    else if (time)
+    {
+        if (strcmp(link->name, name) != 0)
+            logLinkEvent(networks, *time, "%s renamed to %s", link->name, name);
+        if (link->up != up)
+            logLinkEvent(networks, *time, "%s %s", name, up ? "up" : "down");
+        if (link->carrier != carrier)
+            logLinkEvent(networks, *time, "%s carrier %s", name, carrier ? "on" : "off");
+    }
+    memcpy(link->name, name, IFNAMSIZ);
+    link->up = up;
+    link->carrier = carrier;
+}
+
+// Applies an RTM_NEWADDR or RTM_DELADDR message to the table, time as for applyLinkMessage().
+static void applyAddressMessage(Networks *networks, const struct nlmsghdr *header, const struct timespec *time)
+{
+    const struct ifaddrmsg *msg = (const struct ifaddrmsg *)NLMSG_DATA(header);
+    if (msg->ifa_family != AF_INET && msg->ifa_family != AF_INET6)
+        return;
+    Link *link = findLink(networks, msg->ifa_index);
+    if (link == nullptr)
+        return;
+
+    // IFA_LOCAL is the address of the interface on point-to-point links, IFA_ADDRESS the peer's
+    const void *data = nullptr;
+    int len = header->nlmsg_len - NLMSG_LENGTH(sizeof(*msg));
+    for (const struct rtattr *attr = IFA_RTA(msg); RTA_OK(attr, len); attr = RTA_NEXT(attr, len))
+    {
+        if (attr->rta_type == IFA_LOCAL || (attr->rta_type == IFA_ADDRESS && data == nullptr))
+            data = RTA_DATA(attr);
+    }
+    if (data == nullptr)
+        return;
+
+    LinkAddress address;
+    address.family = msg->ifa_family;
+    address.prefix = msg->ifa_prefixlen;
+    inet_ntop(msg->ifa_family, data, address.address, sizeof(address.address));
+
+    auto it = find_if(link->addresses.begin(), link->addresses.end(), [&](const LinkAddress &a) {
+        return a.family == address.family && a.prefix == address.prefix && strcmp(a.address, address.address) == 0;
+    });
+    if (header->nlmsg_type == RTM_NEWADDR && it == link->addresses.end())
+    {
+        link->addresses.push_back(address);
+        if (time)
+            logLinkEvent(networks, *time, "%s address %s/%d added", link->name, address.address, address.prefix);
+    }
+    else if (header->nlmsg_type == RTM_DELADDR && it != link->addresses.end())
+    {
+        link->addresses.erase(it);
+        if (time)
+            logLinkEvent(networks, *time, "%s address %s/%d removed", link->name, address.address, address.prefix);
+    }
+}
+
+// Rebuilds the links and their addresses from a dump.
+static bool dumpLinkTable(Networks *networks)
+{
+    networks->links.clear();
+    struct ifinfomsg info;
+    memset(&info, 0, sizeof(info));
+    info.ifi_family = AF_UNSPEC;
+    if (!rtnlDump(RTM_GETLINK, &info, sizeof(info), [&](const struct nlmsghdr *reply) {
+            if (reply->nlmsg_type == RTM_NEWLINK)
+                applyLinkMessage(networks, reply, nullptr);
+        }))
+        return false;
+
+    struct ifaddrmsg addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.ifa_family = AF_UNSPEC;
+    return rtnlDump(RTM_GETADDR, &addr, sizeof(addr), [&](const struct nlmsghdr *reply) {
+        if (reply->nlmsg_type == RTM_NEWADDR)
+            applyAddressMessage(networks, reply, nullptr);
+    });
+}
+
+// Fills ip4s from the table, for drawIpv4Network().
+static void fillIp4s(Networks *networks)
+{
+    networks->ip4s.clear();
+    for (const Link &link : networks->links)
+    {
+        for (const LinkAddress &address : link.addresses)
+        {
+            if (address.family != AF_INET)
+                continue;
+            IP4 ip;
+            memcpy(ip.name, link.name, IFNAMSIZ);
+            snprintf(ip.addressBuffer, sizeof(ip.addressBuffer), "%s", address.address);
+            networks->ip4s.push_back(ip);
+        }
+    }
+}
+
+/**
+ * Applies the pending notifications to the interface table. The table is
+ * dumped on its first call, and again if the socket dropped notifications.
+ *
+ * @param networks The table, only modified by what the kernel reported.
+ * @return false if rtnetlink is not available, the caller then uses getifaddrs().
+ */
+bool updateLinks(Networks *networks)
+{
+    if (linkEventsFd() < 0 || !openRtnl())
+        return false;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (networks->dump_generation != link_dump_generation)
+    {
+        if (!dumpLinkTable(networks))
+            return false;
+        if (networks->dump_generation != 0)
+            logLinkEvent(networks, now, "notifications lost, interfaces read again");
+        networks->dump_generation = link_dump_generation;
+    }
+
+    alignas(struct nlmsghdr) char buf[16384];
+    char control[CMSG_SPACE(sizeof(struct timespec))];
+    for (;;)
+    {
+        struct iovec iov = {buf, sizeof(buf)};
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        countSyscalls(1);
+        ssize_t n = recvmsg(link_events_socket, &msg, 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == ENOBUFS)
+            {
+                // the queue overflowed, whatever is still queued is applied on top of a new dump
+                link_dump_generation++;
+                return updateLinks(networks);
+            }
+            break;
+        }
+
+        // the time the kernel queued the notification, not the time it is read
+        struct timespec time = now;
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPNS)
+                memcpy(&time, CMSG_DATA(cmsg), sizeof(time));
+        }
+
+        int len = n;
+        for (struct nlmsghdr *header = (struct nlmsghdr *)buf; NLMSG_OK(header, len); header = NLMSG_NEXT(header, len))
+        {
+            if (header->nlmsg_type == RTM_NEWLINK || header->nlmsg_type == RTM_DELLINK)
+                applyLinkMessage(networks, header, &time);
+            else if (header->nlmsg_type == RTM_NEWADDR || header->nlmsg_type == RTM_DELADDR)
+                applyAddressMessage(networks, header, &time);
+        }
+    }
+    fillIp4s(networks);
+    return true;
+}
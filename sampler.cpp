@@ -0,0 +1,251 @@
+#include "header.h"
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+// The sampler thread schedules the collectors of collectors.cpp. Each
+// collector runs on its own period, writes into sampler_state, and the result
+// is published as a Snapshot. The views only ever read the latest one.
+static thread sampler_thread;
+static int sampler_timer_fd = -1; // CLOCK_MONOTONIC timerfd armed on the next deadline
+static int sampler_stop_fd = -1;  // eventfd written by stopSampler()
+
+// Triple buffer between the sampler (writer) and the UI thread (reader).
+// The writer fills snapshot_buffers[snapshot_back], the reader reads
+// snapshot_buffers[snapshot_front], and the third buffer is the one last
+// published. Both sides only swap their own index with snapshot_middle,
+// so neither ever waits for the other.
+static Snapshot snapshot_buffers[3];
+static const unsigned SNAPSHOT_INDEX_MASK = 3;
+static const unsigned SNAPSHOT_FRESH = 4; // set in snapshot_middle until the reader takes it
+static atomic<unsigned> snapshot_middle(1);
+static unsigned snapshot_back = 2;  // sampler thread only
+static unsigned snapshot_front = 0; // UI thread only
+static unsigned long long snapshot_seq = 0;
+static void (*snapshot_listener)() = nullptr; // called on the sampler thread after every publication
+
+// Latest values of every collector, only touched by the sampler thread.
+static Snapshot sampler_state;
+
+// Scheduling state of each collector of collectors.cpp, same indexes.
+struct CollectorSchedule
+{
+    long long next_due_ns;
+    unsigned long long generation;
+    double jitter_total_ms;
+};
+
+static CollectorSchedule schedules[COLLECTOR_COUNT];
+
+// generation of each collector's data held by each buffer of the triple buffer
+static unsigned long long buffer_generation[3][COLLECTOR_COUNT];
+
+// Current CLOCK_MONOTONIC time in nanoseconds.
+long long monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Runs one collector and updates its scheduling statistics.
+ *
+ * @param i The index of the collector in collectors.
+ */
+static void runCollector(int i)
+{
+    const Collector &c = collectors[i];
+    CollectorSchedule &schedule = schedules[i];
+    CollectorStats &stats = sampler_state.collectors[i];
+
+    float jitter_ms = (monotonicNs() - schedule.next_due_ns) / 1e6f;
+    timeCollector(c, sampler_state, stats);
+    recordHistory(i, sampler_state);
+    long long end = monotonicNs();
+
+    schedule.generation++;
+    schedule.jitter_total_ms += jitter_ms;
+    stats.jitter_last_ms = jitter_ms;
+    stats.jitter_avg_ms = schedule.jitter_total_ms / stats.runs;
+    stats.jitter_max_ms = max(stats.jitter_max_ms, jitter_ms);
+
+    if (c.period_ms == 0)
+    {
+        schedule.next_due_ns = LLONG_MAX;
+        return;
+    }
+    // keep the phase, but do not try to catch up on runs that were missed
+    schedule.next_due_ns += c.period_ms * 1000000LL;
+    if (schedule.next_due_ns <= end)
+        schedule.next_due_ns = end + c.period_ms * 1000000LL;
+}
+
+// Brings the back buffer up to date with sampler_state, then publishes it.
+// Only the collectors whose data changed since the buffer was last used are copied.
+static void publishSnapshot()
+{
+    Snapshot &back = snapshot_buffers[snapshot_back];
+    for (int i = 0; i < COLLECTOR_COUNT; i++)
+    {
+        if (buffer_generation[snapshot_back][i] != schedules[i].generation)
+        {
+            collectors[i].copy(sampler_state, back);
+            buffer_generation[snapshot_back][i] = schedules[i].generation;
+        }
+    }
+    copy(begin(sampler_state.collectors), end(sampler_state.collectors), back.collectors);
+    back.seq = ++snapshot_seq;
+
+    unsigned prev = snapshot_middle.exchange(snapshot_back | SNAPSHOT_FRESH, memory_order_acq_rel);
+    snapshot_back = prev & SNAPSHOT_INDEX_MASK;
+    if (snapshot_listener)
+        snapshot_listener();
+}
+
+// Arms the timerfd on the earliest deadline of all collectors.
+static void armTimer()
+{
+    long long next = LLONG_MAX;
+    for (const CollectorSchedule &schedule : schedules)
+        next = min(next, schedule.next_due_ns);
+    if (next == LLONG_MAX)
+        return;
+
+    struct itimerspec its = {};
+    its.it_value.tv_sec = next / 1000000000LL;
+    its.it_value.tv_nsec = next % 1000000000LL;
+    timerfd_settime(sampler_timer_fd, TFD_TIMER_ABSTIME, &its, nullptr);
+}
+
+// Sampler thread body, runs the due collectors on every timer expiry until stopSampler() is called.
+static void samplerLoop()
+{
+    long long start = monotonicNs();
+    for (int i = 0; i < COLLECTOR_COUNT; i++)
+    {
+        schedules[i].next_due_ns = start;
+        sampler_state.collectors[i] = {collectors[i].name, collectors[i].period_ms, collectors[i].cost_ms, 0, 0, 0, 0, 0, 0};
+    }
+
+    // the timer, the stop event, then the event descriptors of the collectors that have one
+    struct pollfd fds[2 + COLLECTOR_COUNT] = {{sampler_timer_fd, POLLIN, 0}, {sampler_stop_fd, POLLIN, 0}};
+    int fd_collector[2 + COLLECTOR_COUNT];
+    int nfds = 2;
+    for (int i = 0; i < COLLECTOR_COUNT; i++)
+    {
+        int fd = collectors[i].event_fd ? collectors[i].event_fd() : -1;
+        if (fd < 0)
+            continue;
+        fds[nfds] = {fd, POLLIN, 0};
+        fd_collector[nfds++] = i;
+    }
+
+    for (;;)
+    {
+        long long now = monotonicNs();
+        unsigned long long syscalls = syscall_count.load(memory_order_relaxed);
+        unsigned long long allocations = threadAllocationCount();
+        bool ran = false;
+        for (int i = 0; i < COLLECTOR_COUNT; i++)
+        {
+            if (schedules[i].next_due_ns <= now)
+            {
+                if (!ran)
+                    advanceFixtures();
+                runCollector(i);
+                ran = true;
+            }
+        }
+        if (ran)
+        {
+            long long publish_start = monotonicNs();
+            publishSnapshot();
+            recordProbe(PROBE_PUBLISH, monotonicNs() - publish_start);
+            recordProbe(PROBE_SAMPLE_SYSCALLS, syscall_count.load(memory_order_relaxed) - syscalls);
+            recordProbe(PROBE_SAMPLE_ALLOCATIONS, threadAllocationCount() - allocations);
+        }
+
+        armTimer();
+        if (poll(fds, nfds, -1) < 0 && errno != EINTR)
+            break;
+        if (fds[1].revents & POLLIN)
+            break;
+        for (int i = 2; i < nfds; i++)
+        {
+            if (fds[i].revents & POLLIN)
+                schedules[fd_collector[i]].next_due_ns = monotonicNs();
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            uint64_t expirations;
+            if (read(sampler_timer_fd, &expirations, sizeof(expirations)) < 0)
+                continue;
+        }
+    }
+}
+
+/**
+ * Sets a function called on the sampler thread every time a snapshot is published,
+ * so the UI can sleep until there is something new to draw. Must be set before startSampler().
+ */
+void setSnapshotListener(void (*listener)())
+{
+    snapshot_listener = listener;
+}
+
+// Starts the sampler thread, every collector runs once right away.
+void startSampler()
+{
+    if (sampler_thread.joinable())
+        return;
+    sampler_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    sampler_stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (sampler_timer_fd < 0 || sampler_stop_fd < 0)
+    {
+        perror("sampler");
+        return;
+    }
+    if (monitor_config.proc_events && !startProcEvents())
+        fprintf(stderr, "proc events unavailable, listing /proc on every sample\n");
+    sampler_thread = thread(samplerLoop);
+}
+
+// Stops the sampler thread and waits for the collector currently running to finish.
+void stopSampler()
+{
+    if (!sampler_thread.joinable())
+        return;
+    uint64_t one = 1;
+    if (write(sampler_stop_fd, &one, sizeof(one)) < 0)
+        perror("sampler");
+    sampler_thread.join();
+    stopScanPool();
+    stopProcEvents();
+    stopCapture();
+    close(sampler_timer_fd);
+    close(sampler_stop_fd);
+}
+
+/**
+ * Makes the newest published snapshot the current one for the UI thread.
+ * Wait-free: a single atomic exchange, and only when something new was published.
+ * Must only be called from the UI thread, once per frame.
+ *
+ * @return The current snapshot, valid until the next call.
+ */
+const Snapshot &acquireSnapshot()
+{
+    if (snapshot_middle.load(memory_order_relaxed) & SNAPSHOT_FRESH)
+    {
+        unsigned prev = snapshot_middle.exchange(snapshot_front, memory_order_acq_rel);
+        snapshot_front = prev & SNAPSHOT_INDEX_MASK;
+    }
+    return snapshot_buffers[snapshot_front];
+}
+
+// Returns the snapshot taken by the last acquireSnapshot() call.
+const Snapshot &getSnapshot()
+{
+    return snapshot_buffers[snapshot_front];
+}
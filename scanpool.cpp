@@ -0,0 +1,168 @@
+#include "header.h"
+#include <condition_variable>
+
+// Worker pool of the process scan. The pid list is cut in chunks, and every
+// worker gets a contiguous shard of chunks. A worker done with its own shard
+// takes the remaining chunks of the others, so one slow shard does not hold
+// the scan back. The thread calling scanPids() works as worker 0.
+
+// pids per chunk, one io_uring batch
+static const size_t SCAN_CHUNK = 64;
+
+struct alignas(64) ScanShard
+{
+    atomic<size_t> next; // next chunk to take, taken with fetch_add by the owner and by thieves
+    size_t end;
+};
+
+static vector<thread> scan_threads;
+static vector<PidScanner *> scan_scanners;
+static vector<vector<Proc>> scan_outputs; // one per worker, merged once every worker is done
+static ScanShard *scan_shards = nullptr;
+static int scan_worker_count = 0;
+
+// current job, published under scan_mutex
+static mutex scan_mutex;
+static condition_variable scan_start;
+static condition_variable scan_done;
+static unsigned long long scan_job = 0;
+static int scan_pending = 0;
+static bool scan_stopping = false;
+static const int *scan_pids;
+static size_t scan_pid_count;
+static double scan_uptime;
+
+// Number of workers allowed by monitor_config: the requested count, at most
+// max_cpu_fraction of the CPUs, and at least one.
+static int scanWorkerLimit()
+{
+    int cpus = max(1u, thread::hardware_concurrency());
+    int limit = max(1, (int)(cpus * monitor_config.max_cpu_fraction));
+    int requested = monitor_config.scan_threads > 0 ? monitor_config.scan_threads : cpus;
+    return min(requested, limit);
+}
+
+// Reads every chunk of the worker's own shard, then steals from the other shards.
+static void runScanWorker(int worker)
+{
+    vector<Proc> &out = scan_outputs[worker];
+    out.clear();
+    for (int k = 0; k < scan_worker_count; k++)
+    {
+        ScanShard &shard = scan_shards[(worker + k) % scan_worker_count];
+        for (;;)
+        {
+            size_t chunk = shard.next.fetch_add(1, memory_order_relaxed);
+            if (chunk >= shard.end)
+                break;
+            size_t first = chunk * SCAN_CHUNK;
+            size_t count = min(SCAN_CHUNK, scan_pid_count - first);
+            readPidStats(*scan_scanners[worker], scan_pids + first, count, scan_uptime, out);
+        }
+    }
+}
+
+// seen is the last job posted before the thread started
+static void scanWorkerLoop(int worker, unsigned long long seen)
+{
+    for (;;)
+    {
+        {
+            unique_lock<mutex> lock(scan_mutex);
+            scan_start.wait(lock, [&] { return scan_stopping || scan_job != seen; });
+            if (scan_stopping)
+                return;
+            seen = scan_job;
+        }
+        runScanWorker(worker);
+        lock_guard<mutex> lock(scan_mutex);
+        if (--scan_pending == 0)
+            scan_done.notify_one();
+    }
+}
+
+// Creates the scanners and the worker threads, on the first scan.
+static void startScanPool()
+{
+    scan_worker_count = scanWorkerLimit();
+    scan_shards = new ScanShard[scan_worker_count];
+    scan_outputs.resize(scan_worker_count);
+    for (int i = 0; i < scan_worker_count; i++)
+        scan_scanners.push_back(createPidScanner(monitor_config.io_uring));
+    for (int i = 1; i < scan_worker_count; i++)
+        scan_threads.push_back(thread(scanWorkerLoop, i, scan_job));
+}
+
+// Stops the worker threads and frees the scanners, the next scan starts the pool again.
+void stopScanPool()
+{
+    {
+        lock_guard<mutex> lock(scan_mutex);
+        scan_stopping = true;
+    }
+    scan_start.notify_all();
+    for (thread &t : scan_threads)
+        t.join();
+    for (PidScanner *scanner : scan_scanners)
+        destroyPidScanner(scanner);
+    scan_threads.clear();
+    scan_scanners.clear();
+    scan_outputs.clear();
+    delete[] scan_shards;
+    scan_shards = nullptr;
+    scan_worker_count = 0;
+    scan_stopping = false;
+}
+
+// Number of threads reading the process table, including the caller of scanPids().
+int scanPoolSize()
+{
+    return scan_worker_count;
+}
+
+/**
+ * Reads the stat file of every pid with the worker pool.
+ *
+ * @param pids The pids to read.
+ * @param uptime The seconds since boot, for the CPU usage.
+ * @param processes Receives one Proc per process that still exists, in no particular order.
+ */
+void scanPids(const vector<int> &pids, double uptime, vector<Proc> &processes)
+{
+    if (scan_worker_count == 0)
+        startScanPool();
+
+    size_t chunks = (pids.size() + SCAN_CHUNK - 1) / SCAN_CHUNK;
+    for (int i = 0; i < scan_worker_count; i++)
+    {
+        scan_shards[i].next.store(chunks * i / scan_worker_count, memory_order_relaxed);
+        scan_shards[i].end = chunks * (i + 1) / scan_worker_count;
+    }
+    scan_pids = pids.data();
+    scan_pid_count = pids.size();
+    scan_uptime = uptime;
+
+    if (scan_worker_count > 1)
+    {
+        {
+            lock_guard<mutex> lock(scan_mutex);
+            scan_pending = scan_worker_count - 1;
+            scan_job++;
+        }
+        scan_start.notify_all();
+    }
+    runScanWorker(0);
+    if (scan_worker_count > 1)
+    {
+        unique_lock<mutex> lock(scan_mutex);
+        scan_done.wait(lock, [] { return scan_pending == 0; });
+    }
+
+    processes.clear();
+    for (const vector<Proc> &out : scan_outputs)
+        processes.insert(processes.end(), out.begin(), out.end());
+    // the scan that started the pool was synchronous, so the io-wq workers
+    // are started by the second scan rather than delay the first sample
+    for (PidScanner *scanner : scan_scanners)
+        scanner->warm = true;
+}
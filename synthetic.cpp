@@ -0,0 +1,128 @@
+#include "header.h"
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+// Synthetic /proc and /sys trees, for running the collectors against more
+// processes, interfaces and cores than the machine has. The monitor reads
+// them with --proc-root DIR/proc --sys-root DIR/sys, see setFileRoots().
+// Only the files the collectors read are written, with fixed content: the
+// usages computed from two samples of a synthetic tree are 0.
+
+/**
+ * A /proc/stat as seen on a machine with the given number of cores.
+ */
+string syntheticStat(int cores)
+{
+    string stat = "cpu  5183766 1245 1829374 183928471 38271 0 28173 0 0 0\n";
+    char line[128];
+    for (int i = 0; i < cores; i++)
+    {
+        snprintf(line, sizeof(line), "cpu%d 27000%d 6 9528%d 957962%d 199 0 146 0 0 0\n", i, i % 10, i % 7, i % 3);
+        stat += line;
+    }
+    stat += "intr 1829374 0 0 0 0 0\nctxt 38192837\nbtime 1700000000\n";
+    return stat;
+}
+
+/**
+ * A /proc/net/dev with the given number of interfaces.
+ */
+string syntheticNetDev(int interfaces)
+{
+    string net_dev = "Inter-|   Receive                                                |  Transmit\n"
+                     " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n";
+    char line[256];
+    for (int i = 0; i < interfaces; i++)
+    {
+        snprintf(line, sizeof(line), "veth%d: 3892837465 2837465 0 12 0 0 0 173 1928374655 1827364 0 0 0 0 0 0\n", i);
+        net_dev += line;
+    }
+    return net_dev;
+}
+
+// A /proc/[pid]/stat, the fields vary with the pid so the sorts of the process table have work to do.
+static int syntheticPidStat(int pid, char *buf, size_t size)
+{
+    return snprintf(buf, size,
+                    "%d (worker-%d) S 1 %d %d 0 -1 4194560 %d 0 0 0 %d %d 0 0 20 0 1 0 %d %llu %d "
+                    "18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 %d 0 0 0 0 0\n",
+                    pid, pid % 1000, pid, pid, pid % 4096, pid * 7 % 100000, pid * 3 % 50000, 100 + pid * 11 % 90000,
+                    4096ULL * (1000 + pid % 250000), 100 + pid * 13 % 50000, pid % 8);
+}
+
+static bool writeFile(const string &path, const char *content, size_t len)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+    bool ok = write(fd, content, len) == (ssize_t)len;
+    close(fd);
+    return ok;
+}
+
+static bool writeFile(const string &path, const string &content)
+{
+    return writeFile(path, content.data(), content.size());
+}
+
+// Creates path and its missing parents.
+static bool makeDirs(const string &path)
+{
+    for (size_t slash = path.find('/', 1); slash != string::npos; slash = path.find('/', slash + 1))
+        mkdir(path.substr(0, slash).c_str(), 0755);
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+/**
+ * Writes a synthetic tree: root/proc with stat, cpuinfo, meminfo, uptime,
+ * net/dev and one [pid]/stat per process, and root/sys with the thermal
+ * zone and hwmon files read by the sensors collector.
+ *
+ * @param root The directory to fill, created if missing.
+ * @param processes Number of processes, pids 1 to processes.
+ * @param interfaces Number of interfaces of /proc/net/dev.
+ * @param cores Number of cores of /proc/stat and /proc/cpuinfo.
+ * @return false if a file could not be written.
+ */
+bool writeSyntheticTree(const char *root, int processes, int interfaces, int cores)
+{
+    string proc = string(root) + "/proc";
+    string sys = string(root) + "/sys";
+    if (!makeDirs(proc + "/net") || !makeDirs(sys + "/class/thermal/thermal_zone0") || !makeDirs(sys + "/class/hwmon/hwmon7"))
+        return false;
+
+    string cpuinfo;
+    char line[128];
+    for (int i = 0; i < cores; i++)
+    {
+        snprintf(line, sizeof(line), "processor\t: %d\nphysical id\t: 0\ncore id\t\t: %d\n\n", i, i);
+        cpuinfo += line;
+    }
+    bool ok = writeFile(proc + "/stat", syntheticStat(cores)) && writeFile(proc + "/cpuinfo", cpuinfo) &&
+              writeFile(proc + "/meminfo", "MemTotal:       65536000 kB\nMemFree:        32768000 kB\n"
+                                           "MemAvailable:   40960000 kB\nSwapTotal:       8388608 kB\n"
+                                           "SwapFree:        8000000 kB\n") &&
+              writeFile(proc + "/uptime", "864000.00 6912000.00\n") && writeFile(proc + "/net/dev", syntheticNetDev(interfaces)) &&
+              writeFile(sys + "/class/thermal/thermal_zone0/temp", "45000\n") &&
+              writeFile(sys + "/class/hwmon/hwmon7/fan1_input", "2100\n") &&
+              writeFile(sys + "/class/hwmon/hwmon7/pwm1_enable", "2\n");
+
+    char stat[512];
+    for (int pid = 1; ok && pid <= processes; pid++)
+    {
+        string dir = proc + "/" + to_string(pid);
+        ok = mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST;
+        ok = ok && writeFile(dir + "/stat", stat, syntheticPidStat(pid, stat, sizeof(stat)));
+    }
+    return ok;
+}
+
+/**
+ * Deletes a tree written by writeSyntheticTree(), or any other directory.
+ */
+void removeTree(const char *root)
+{
+    nftw(root, [](const char *path, const struct stat *, int, struct FTW *) { return remove(path); }, 64,
+         FTW_DEPTH | FTW_PHYS);
+}
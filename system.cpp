@@ -51,50 +51,103 @@ const char *getOsName()
 }
 
 /**
- * Retrieves the number of running processes on the system by counting the number of directories in the /proc directory
- * that have a numeric name.
+ * Counts the physical cores listed in /proc/cpuinfo, one per distinct
+ * (physical id, core id) pair.
  *
- * @return The number of running processes on the system.
+ * @return The number of physical cores, or 0 if /proc/cpuinfo has no topology.
  */
-int getProcesses()
+static int getCoreCount()
 {
-    int processes = 0;
-    filesystem::path procPath ("/proc");
-    for(const auto& entry: filesystem::directory_iterator(procPath))
+    char path[PATH_MAX];
+    ifstream cpuinfo(rootedPath("/proc/cpuinfo", path, sizeof(path)));
+    set<pair<int, int>> cores;
+    string line;
+    int physical_id = 0;
+    while (getline(cpuinfo, line))
+    {
+        if (line.compare(0, 11, "physical id") == 0)
+            physical_id = atoi(line.c_str() + line.find(':') + 1);
+        else if (line.compare(0, 7, "core id") == 0)
+            cores.insert({physical_id, atoi(line.c_str() + line.find(':') + 1)});
+    }
+    return cores.size();
+}
+
+/**
+ * Fills the static facts about the machine: OS, CPU brand, core and thread
+ * counts and kernel release, plus the hostname and user.
+ * Meant to run once, at startup.
+ *
+ * @param info A pointer to the SystemInfo object to fill.
+ */
+void getSystemInfo(SystemInfo *info)
+{
+    info->os = getOsName();
+    info->cpu_brand = CPUinfo();
+    info->threads = sysconf(_SC_NPROCESSORS_ONLN);
+    info->cores = getCoreCount();
+    if (info->cores == 0)
+        info->cores = info->threads;
+
+    struct utsname uts;
+    countSyscalls(1);
+    if (uname(&uts) == 0)
+        info->kernel_release = uts.release;
+
+    info->utmp_mtime = -1;
+    refreshHostInfo(info);
+}
+
+/**
+ * Updates the hostname and the logged in user when they changed.
+ * The hostname is compared against uname(), getlogin() is only called again
+ * when the utmp file was modified, since it has to read that file.
+ *
+ * @param info A pointer to the SystemInfo object to update.
+ */
+void refreshHostInfo(SystemInfo *info)
+{
+    struct utsname uts;
+    countSyscalls(2);
+    if (uname(&uts) == 0 && info->hostname != uts.nodename)
+        info->hostname = uts.nodename;
+
+    struct stat st;
+    time_t mtime = (stat(_PATH_UTMP, &st) == 0) ? st.st_mtime : 0;
+    if (mtime != info->utmp_mtime)
     {
-        if (entry.is_directory() && isdigit(entry.path().filename().string()[0]))
-            ++processes;
+        info->utmp_mtime = mtime;
+        const char *login = getlogin();
+        info->user = (login != nullptr) ? login : "";
     }
-    return processes;
 }
 
+static ProcFile proc_stat_file = {"/proc/stat", -1};
+static ProcFile fan_speed_file = {"/sys/class/hwmon/hwmon7/fan1_input", -1};
+static ProcFile fan_level_file = {"/sys/class/hwmon/hwmon7/pwm1_enable", -1};
+static ProcFile cpu_temp_file = {"/sys/class/thermal/thermal_zone0/temp", -1};
+
 /**
  * Retrieves CPU statistics from the /proc/stat file.
  *
  * @param cpu_s A reference to a CPUStats object where the retrieved statistics will be stored.
+ * @param cores Receives the statistics of every core.
  */
-void getCPUStats(CPUStats &cpu_s)
+void getCPUStats(CPUStats &cpu_s, vector<CPUStats> &cores)
 {
-    ifstream proceStat("/proc/stat");
-    string line;
-    getline(proceStat, line);
-    istringstream iss(line);
-    string cpuLabel;
-    iss >> cpuLabel;
-    iss >> cpu_s.user >> cpu_s.nice >> cpu_s.system >> cpu_s.idle >> cpu_s.iowait >> cpu_s.irq >> cpu_s.softirq >> cpu_s.steal >>cpu_s.guest >>cpu_s.guestNice; 
+    if (readProcFile(proc_stat_file))
+        parseCPUStat(proc_stat_file.buf.data(), proc_stat_file.len, cpu_s, cores);
 }
 
 /**
- * Calculates the CPU usage percentage based on the difference between the current and previous CPU statistics.
+ * Calculates the CPU usage percentage based on the difference between two CPU statistics.
  *
- * @param prev_cpu_s A reference to a CPUStats object containing the previous CPU statistics.
+ * @param prev_cpu_s The previous CPU statistics.
+ * @param curr_cpu_s The current CPU statistics.
  * @return The CPU usage percentage.
  */
-float getCPUUsage(CPUStats &prev_cpu_s)
+static float getUsageBetween(const CPUStats &prev_cpu_s, const CPUStats &curr_cpu_s)
 {
-    CPUStats curr_cpu_s;
-    getCPUStats(curr_cpu_s);
-
     long long int prev_idle = prev_cpu_s.user + prev_cpu_s.nice + prev_cpu_s.system;
     long long int curr_idle = curr_cpu_s.user + curr_cpu_s.nice+curr_cpu_s.system;
    
@@ -110,47 +163,33 @@ float getCPUUsage(CPUStats &prev_cpu_s)
      long long int total_diff = curr_total - prev_total;
      long long int idle_diff = curr_idle - prev_idle;
 
-    float cpuUsage = 100.0f*static_cast<float>(idle_diff)/static_cast<float>(total_diff);
-
-    prev_cpu_s = curr_cpu_s;
-    return cpuUsage;
+    if (total_diff <= 0)
+        return 0.0f;
+    return 100.0f*static_cast<float>(idle_diff)/static_cast<float>(total_diff);
 }
 
 /**
- * Retrieves CPU statistics from the /proc/stat file and displays them using ImGui.
+ * Calculates the CPU usage percentage of the machine and of every core since the previous call.
  *
- * This function retrieves CPU statistics and displays them in a plot using ImGui. It uses the getCPUUsage function to calculate the CPU usage percentage and stores it in the values array. The plot is updated based on the animate checkbox and the fps slider. The scale slider controls the maximum value displayed on the plot. The CPU usage percentage is displayed as overlay text on the plot.
+ * @param prev_cpu_s A reference to a CPUStats object containing the previous CPU statistics, updated.
+ * @param prev_cores The previous statistics of every core, updated.
+ * @param core_usage Receives the usage percentage of every core.
+ * @return The CPU usage percentage.
  */
-void getCPUTabbed()
+float getCPUUsage(CPUStats &prev_cpu_s, vector<CPUStats> &prev_cores, vector<float> &core_usage)
 {
-    const int GSIZE = 100;
-    static CPUStats prev_cpu_s ={0,0,0,0,0,0,0,0,0,0};
-    static int fps = 1;
-    static int index = 0;
-    static float timer =0.0f;
-    static float scale = 100.0f;
-    static float values[100] = {0};
-    static bool animate = true;
-    static float cpu_usage;
-    char overlay_text[32];
+    static CPUStats curr_cpu_s;
+    static vector<CPUStats> curr_cores;
+    getCPUStats(curr_cpu_s, curr_cores);
 
-    ImGui::Checkbox("Animate", &animate);
-    ImGui::SliderInt("FPS", &fps, 0, 60);
-    ImGui::SliderFloat("scale max", &scale, 0, 100);
+    float cpuUsage = getUsageBetween(prev_cpu_s, curr_cpu_s);
+    core_usage.resize(curr_cores.size());
+    for (size_t i = 0; i < curr_cores.size(); i++)
+        core_usage[i] = (i < prev_cores.size()) ? getUsageBetween(prev_cores[i], curr_cores[i]) : 0.0f;
 
-    if(animate)
-    {
-        timer += ImGui::GetIO().DeltaTime;
-        if(timer > 1.0f /fps)
-        {
-        cpu_usage = getCPUUsage(prev_cpu_s);
-        values[index] = cpu_usage;
-        index = (index + 1) % GSIZE;
-        timer -= 1.0/fps;
-        }
-    }
-        sprintf(overlay_text, "CPU Usage: %.2f%%", cpu_usage);
-    ImGui::PlotLines("CPU", values, GSIZE, index, overlay_text, 0.0f, scale, ImVec2(0, 100));
+    prev_cpu_s = curr_cpu_s;
+    prev_cores.swap(curr_cores);
+    return cpuUsage;
 }
 
 /**
@@ -160,10 +199,9 @@ void getCPUTabbed()
  */
 string getSpeedFan()
 {
-    ifstream speedFan("/sys/class/hwmon/hwmon7/fan1_input");
-    string speed;
-    getline(speedFan, speed);
-    return speed;
+    if (!readProcFile(fan_speed_file))
+        return "";
+    return string(fan_speed_file.buf.data(), strcspn(fan_speed_file.buf.data(), "\n"));
 }
 
 /**
@@ -173,56 +211,11 @@ string getSpeedFan()
  */
 string getFanLevel()
 {
-    ifstream fanLevel("/sys/class/hwmon/hwmon7/pwm1_enable");
-    string level;
-    getline(fanLevel, level);
-    int lvl = atoi(level.c_str());
+    int lvl = readProcFile(fan_level_file) ? atoi(fan_level_file.buf.data()) : 0;
     string output = (lvl == 1) ? "auto" : "manual";
     return output;
 }
 
-/**
- * Retrieves fan statistics and displays them using ImGui.
- * The function retrieves the fan speed, status, and level from external functions.
- * It then displays the fan status, level, and speed in RPM using ImGui.
- * The function also provides options to animate the fan speed graph and adjust the FPS and scale.
- * The fan speed is plotted on a graph using ImGui's PlotLines function.
- */
-void getFanTabbed()
-{
-    const int GSIZE = 100;
-    static int fps = 1;
-    static int index = 0;
-    static float timer = 0.0f;
-    static float scale = 2000.0f;
-    static float values[100]={0};
-    static bool animate = true;
-
-    const char *speed_fan = getSpeedFan().c_str();
-    const char *status_fan = (atoi(speed_fan) > 0 ) ? "enabled" : "disabled";
-    const char *level_fan = getFanLevel().c_str();
-   
-    ImGui::Text("Status: %s         Level: %s         Speed: %s RPM", status_fan, level_fan, speed_fan);
-    ImGui::Checkbox("Animate", &animate);
-    ImGui::SliderInt("FPS", &fps, 0, 60);
-    ImGui::SliderFloat("scale max", &scale, 0, 10000);
-
-    if(animate)
-    {
-        timer += ImGui::GetIO().DeltaTime;
-        if(timer > 1.0f / fps)
-        {
-            values[index] = stof(speed_fan);
-            index = (index + 1) % GSIZE;
-            timer -= 1.0/fps;
-        }
-    }
-
-    char overlay_text[32];
-    sprintf(overlay_text, "Speed: %.0f RPM", stof(speed_fan));
-    ImGui::PlotLines("CPU", values, GSIZE, index, overlay_text, 0.0f, scale, ImVec2(0, 100));
-}
-
 /**
  * Retrieves the CPU temperature from the /sys/class/thermal/thermal_zone0/temp file.
  *
@@ -230,76 +223,28 @@ void getFanTabbed()
  */
 float getCPUTemp()
 {
-    string temp;
-    ifstream cpuTemp("/sys/class/thermal/thermal_zone0/temp");
-    string line;
-    getline(cpuTemp, line);
-    istringstream iss(line);
-    iss >> temp;
-    return stof(temp)/1000.00;
+    if (!readProcFile(cpu_temp_file))
+        return 0.0f;
+    return atof(cpu_temp_file.buf.data())/1000.00;
 }
 
 /**
- * Retrieves CPU temperature and displays it using ImGui.
- * Allows the user to animate the temperature graph, adjust the FPS, and scale the maximum value.
+ * Measures the CPU time used by the whole monitor, all threads included,
+ * since the previous call.
+ *
+ * @return The usage in percent of one CPU.
  */
-void getThermalTabbed()
-{
-    const int GSIZE = 100;
-    static int fps = 1;
-    static int index = 0;
-    static float timer = 0.0f;
-    static float scale = 100.0f;
-    static float values[100]={0};
-    static bool animate = true;
-
-    float cpu_temp = getCPUTemp();
-
-    ImGui::Text("Temperature: %.1f", cpu_temp);
-    ImGui::Checkbox("Animate", &animate);
-    ImGui::SliderInt("FPS", &fps, 0, 60);
-    ImGui::SliderFloat("scale max", &scale, 0, 100);
-
-    if(animate)
-    {
-        timer += ImGui::GetIO().DeltaTime;
-        if(timer > 1.0f / fps)
-        {
-            values[index] = cpu_temp;
-            index = (index + 1) % GSIZE;
-            timer -= 1.0/fps;
-        }
-    }
-    char overlay_text[32];
-    sprintf(overlay_text, "Temp: %.1f °C", cpu_temp);
-    ImGui::PlotLines("CPU", values, GSIZE, index, overlay_text, 0.0f, scale, ImVec2(0, 100));
-}
-
-// Draw Container in system window
-void drawTabbedContainer()
+float getMonitorCPUUsage()
 {
-    if(ImGui::BeginTabBar("##TabBar"))
-    {   
-        // CPU tabbed
-        if (ImGui::BeginTabItem("CPU"))
-        {
-            getCPUTabbed();
-            ImGui::EndTabItem();
-        }
-        // Fan tabbed
-        if (ImGui::BeginTabItem("Fan"))
-        {
-            ImGui::Text("Fan informations");
-            getFanTabbed();
-            ImGui::EndTabItem();
-        }
-        // Thermal tabbed
-        if (ImGui::BeginTabItem("Thermal"))
-        {
-            ImGui::Text("Thermal informations");
-            getThermalTabbed();
-            ImGui::EndTabItem();
-        }
-    ImGui::EndTabBar();
-    }
+    static long long prev_cpu_us = 0;
+    static long long prev_ns = 0;
+    struct rusage usage;
+    countSyscalls(1);
+    getrusage(RUSAGE_SELF, &usage);
+    long long cpu_us = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    long long now = monotonicNs();
+    float percent = prev_ns == 0 ? 0.0f : 100.0f * (cpu_us - prev_cpu_us) * 1000.0f / (now - prev_ns);
+    prev_cpu_us = cpu_us;
+    prev_ns = now;
+    return percent;
 }
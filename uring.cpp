@@ -0,0 +1,335 @@
+#include "header.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+// A minimal io_uring, set up with the raw syscalls, just enough to batch the
+// openat/read/close of every /proc/[pid]/stat of a process scan.
+// When io_uring is missing or lacks one of the three operations, the scan
+// falls back to synchronous syscalls, see readPidStats().
+
+struct Uring
+{
+    int fd = -1;
+    void *sq_ring = MAP_FAILED;
+    void *cq_ring = MAP_FAILED;
+    size_t sq_ring_size = 0;
+    size_t cq_ring_size = 0;
+    io_uring_sqe *sqes = (io_uring_sqe *)MAP_FAILED;
+    size_t sqes_size = 0;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe *cqes;
+    unsigned sq_entries;
+};
+
+// Number of pids handled by one submission, the ring has twice as many entries for the linked read+close.
+static const unsigned URING_BATCH = 64;
+static const size_t PID_STAT_SIZE = 1024;
+
+static void uringExit(Uring &ring)
+{
+    if (ring.sqes != MAP_FAILED)
+        munmap(ring.sqes, ring.sqes_size);
+    if (ring.cq_ring != MAP_FAILED && ring.cq_ring != ring.sq_ring)
+        munmap(ring.cq_ring, ring.cq_ring_size);
+    if (ring.sq_ring != MAP_FAILED)
+        munmap(ring.sq_ring, ring.sq_ring_size);
+    if (ring.fd >= 0)
+        close(ring.fd);
+    ring = Uring();
+}
+
+// Checks that the kernel supports the openat, read and close operations.
+static bool uringSupportsScan(int ring_fd)
+{
+    size_t size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    vector<char> buf(size, 0);
+    io_uring_probe *probe = (io_uring_probe *)buf.data();
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, 256) < 0)
+        return false;
+    for (int op : {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE})
+    {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Sets up a ring and maps its submission and completion queues.
+ *
+ * @return false if io_uring is not available, ring is left closed.
+ */
+static bool uringInit(Uring &ring, unsigned entries)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring.fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring.fd < 0 || !uringSupportsScan(ring.fd))
+    {
+        uringExit(ring);
+        return false;
+    }
+
+    ring.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring.sq_ring_size = ring.cq_ring_size = max(ring.sq_ring_size, ring.cq_ring_size);
+
+    ring.sq_ring = mmap(nullptr, ring.sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+    if (ring.sq_ring == MAP_FAILED)
+    {
+        uringExit(ring);
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring.cq_ring = ring.sq_ring;
+    else
+        ring.cq_ring = mmap(nullptr, ring.cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+    ring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    ring.sqes = (io_uring_sqe *)mmap(nullptr, ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+    if (ring.cq_ring == MAP_FAILED || ring.sqes == MAP_FAILED)
+    {
+        uringExit(ring);
+        return false;
+    }
+
+    char *sq = (char *)ring.sq_ring;
+    char *cq = (char *)ring.cq_ring;
+    ring.sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring.sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring.sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring.sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring.cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring.cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring.cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring.cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+    ring.sq_entries = params.sq_entries;
+    return true;
+}
+
+// Returns the next free submission entry, cleared. The caller checked there is room.
+static io_uring_sqe *uringGetSqe(Uring &ring)
+{
+    unsigned tail = *ring.sq_tail;
+    unsigned index = tail & *ring.sq_mask;
+    io_uring_sqe *sqe = &ring.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring.sq_array[index] = index;
+    __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+// Submits the queued entries and waits until wait completions are available.
+// Returns the number of entries the kernel took, each of which completes, or -1.
+// The kernel does not wait when it took fewer than submit; the entries it left
+// are dropped from the queue so the next submission does not send them.
+static int uringSubmitAndWait(Uring &ring, unsigned submit, unsigned wait)
+{
+    countSyscalls(1);
+    int ret;
+    do
+    {
+        ret = syscall(__NR_io_uring_enter, ring.fd, submit, wait, IORING_ENTER_GETEVENTS, nullptr, 0);
+    } while (ret < 0 && errno == EINTR);
+    if (ret != (int)submit)
+        __atomic_store_n(ring.sq_tail, __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    return ret;
+}
+
+// Pops one completion, there must be one available.
+static io_uring_cqe uringPopCqe(Uring &ring)
+{
+    unsigned head = *ring.cq_head;
+    while (head == __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE))
+        uringSubmitAndWait(ring, 0, 1);
+    io_uring_cqe cqe = ring.cqes[head & *ring.cq_mask];
+    __atomic_store_n(ring.cq_head, head + 1, __ATOMIC_RELEASE);
+    return cqe;
+}
+
+/**
+ * Creates the state needed to scan processes: a descriptor on /proc,
+ * the read buffers and, when use_io_uring is set and the kernel supports it, a ring.
+ */
+PidScanner *createPidScanner(bool use_io_uring)
+{
+    PidScanner *scanner = new PidScanner;
+    scanner->proc_fd = openProcDir();
+    scanner->ring = new Uring;
+    scanner->uring = use_io_uring && uringInit(*scanner->ring, URING_BATCH * 2);
+    scanner->warm = false;
+    scanner->buffers.resize(URING_BATCH * PID_STAT_SIZE);
+    return scanner;
+}
+
+void destroyPidScanner(PidScanner *scanner)
+{
+    if (scanner == nullptr)
+        return;
+    uringExit(*scanner->ring);
+    delete scanner->ring;
+    if (scanner->proc_fd >= 0)
+        close(scanner->proc_fd);
+    delete scanner;
+}
+
+// Parses one /proc/[pid]/stat and appends the process to out.
+static void addPidStat(const char *buf, ssize_t len, double uptime, vector<Proc> &out)
+{
+    Proc proc;
+    if (len > 0 && parsePidStat(buf, len, proc))
+    {
+        computeProcUsage(proc, uptime);
+        out.push_back(proc);
+    }
+}
+
+// Synchronous path: openat/read/close for every pid.
+static void readPidStatsSync(PidScanner &scanner, const int *pids, size_t count, double uptime, vector<Proc> &out)
+{
+    char *buf = scanner.buffers.data();
+    char path[32];
+    for (size_t i = 0; i < count; i++)
+    {
+        snprintf(path, sizeof(path), "%d/stat", pids[i]);
+        addPidStat(buf, readSmallFileAt(scanner.proc_fd, path, buf, PID_STAT_SIZE), uptime, out);
+    }
+}
+
+/**
+ * io_uring path. Every batch costs two submissions: all the openat first,
+ * then a read hard-linked to a close for every file that could be opened.
+ */
+static void readPidStatsUring(PidScanner &scanner, const int *pids, size_t count, double uptime, vector<Proc> &out)
+{
+    Uring &ring = *scanner.ring;
+    char paths[URING_BATCH][32];
+    int fds[URING_BATCH];
+    ssize_t lens[URING_BATCH];
+
+    for (size_t first = 0; first < count; first += URING_BATCH)
+    {
+        unsigned batch = min((size_t)URING_BATCH, count - first);
+
+        for (unsigned i = 0; i < batch; i++)
+        {
+            snprintf(paths[i], sizeof(paths[i]), "%d/stat", pids[first + i]);
+            io_uring_sqe *sqe = uringGetSqe(ring);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = scanner.proc_fd;
+            sqe->addr = (unsigned long)paths[i];
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            sqe->user_data = i;
+        }
+        int taken = uringSubmitAndWait(ring, batch, batch);
+        if (taken != (int)batch)
+        {
+            // the opens that went through still complete, their files are closed here
+            for (int n = 0; n < taken; n++)
+            {
+                io_uring_cqe cqe = uringPopCqe(ring);
+                if (cqe.res >= 0)
+                    close(cqe.res);
+            }
+            readPidStatsSync(scanner, pids + first, count - first, uptime, out);
+            return;
+        }
+        for (unsigned i = 0; i < batch; i++)
+        {
+            io_uring_cqe cqe = uringPopCqe(ring);
+            fds[cqe.user_data] = cqe.res; // negative when the process already exited
+        }
+
+        unsigned submitted = 0;
+        for (unsigned i = 0; i < batch; i++)
+        {
+            lens[i] = -1;
+            if (fds[i] < 0)
+                continue;
+            io_uring_sqe *sqe = uringGetSqe(ring);
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = fds[i];
+            sqe->addr = (unsigned long)(scanner.buffers.data() + i * PID_STAT_SIZE);
+            sqe->len = PID_STAT_SIZE - 1;
+            sqe->off = 0;
+            sqe->flags = IOSQE_IO_HARDLINK; // a short read would break a plain link
+            sqe->user_data = i << 1;
+
+            sqe = uringGetSqe(ring);
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = fds[i];
+            sqe->user_data = (i << 1) | 1;
+            submitted += 2;
+        }
+        if (submitted == 0)
+            continue;
+        taken = uringSubmitAndWait(ring, submitted, submitted);
+        if (taken != (int)submitted)
+        {
+            // the entries that went through still complete, the files whose close did not run are closed here
+            for (int n = 0; n < taken; n++)
+            {
+                io_uring_cqe cqe = uringPopCqe(ring);
+                if ((cqe.user_data & 1) && cqe.res != -ECANCELED)
+                    fds[cqe.user_data >> 1] = -1;
+            }
+            for (unsigned i = 0; i < batch; i++)
+                if (fds[i] >= 0)
+                    close(fds[i]);
+            readPidStatsSync(scanner, pids + first, count - first, uptime, out);
+            return;
+        }
+        for (unsigned n = 0; n < submitted; n++)
+        {
+            io_uring_cqe cqe = uringPopCqe(ring);
+            unsigned i = cqe.user_data >> 1;
+            if (cqe.user_data & 1)
+            {
+                // only happens if the read could not be started
+                if (cqe.res == -ECANCELED)
+                {
+                    countSyscalls(1);
+                    close(fds[i]);
+                }
+            }
+            else
+            {
+                lens[i] = cqe.res;
+            }
+        }
+
+        for (unsigned i = 0; i < batch; i++)
+        {
+            if (lens[i] <= 0)
+                continue;
+            char *buf = scanner.buffers.data() + i * PID_STAT_SIZE;
+            buf[lens[i]] = '\0';
+            addPidStat(buf, lens[i], uptime, out);
+        }
+    }
+}
+
+/**
+ * Reads and parses /proc/[pid]/stat for every pid, appending one Proc per
+ * process that still exists to out.
+ *
+ * The ring is only used once the scanner is warm: its first submission has
+ * the kernel start the io-wq workers of the process, a few ms, longer than
+ * a synchronous scan of a usual process table.
+ *
+ * @param scanner From createPidScanner(), must only be used by one thread at a time.
+ * @param pids The pids to read.
+ * @param count The number of pids.
+ * @param uptime The seconds since boot, for the CPU usage.
+ * @param out Receives the processes, in the order of pids.
+ */
+void readPidStats(PidScanner &scanner, const int *pids, size_t count, double uptime, vector<Proc> &out)
+{
+    if (scanner.uring && scanner.warm)
+        readPidStatsUring(scanner, pids, count, uptime, out);
+    else
+        readPidStatsSync(scanner, pids, count, uptime, out);
+}
@@ -0,0 +1,977 @@
+#include "header.h"
+#include "imgui_internal.h"
+
+// The views: every function here draws a Snapshot published by the sampler
+// with ImGui, and never reads the kernel itself. The data comes from the
+// collectors in collectors.cpp, which in turn never touch ImGui.
+
+// system window
+
+// Shortest span the history plots zoom in to, in seconds, and the span they open with.
+static const double HISTORY_PLOT_MIN_SPAN = 60;
+static const double HISTORY_PLOT_SPAN = 120;
+// Refreshes per second of an animated plot until its slider is moved.
+static const float HISTORY_PLOT_FPS = 10;
+
+// A plot of a series of the history store, with its controls, kept by the tab drawing it.
+struct HistoryPlot
+{
+    const char *metric;
+    float scale;
+    bool animate; // the right edge follows the current time
+    bool quantiles; // draws the p50, p95 and p99 of the window, see historyQuantiles()
+    double span;  // seconds shown, 0 before the first frame
+    double end;   // time of the right edge, in CLOCK_REALTIME seconds
+    float fps;    // reads of the store per second while animated
+    // the window and sample the columns were read for, and when
+    double shown_start;
+    double shown_span;
+    unsigned long long shown_seq;
+    double shown_time; // ImGui::GetTime()
+    int level;
+    vector<HistoryPoint> columns; // one per pixel
+    float quantile_values[3];
+    unsigned long long quantile_count; // values in the window
+};
+
+static const double history_plot_quantiles[3] = {0.5, 0.95, 0.99};
+static const char *history_plot_quantile_names[3] = {"p50", "p95", "p99"};
+
+// "2 min", "3.5 h": a span of the history plots.
+static void formatSpan(double seconds, char *buf, size_t size)
+{
+    if (seconds < 2 * 60)
+        snprintf(buf, size, "%.0f s", seconds);
+    else if (seconds < 2 * 3600)
+        snprintf(buf, size, "%.0f min", seconds / 60);
+    else if (seconds < 2 * 86400)
+        snprintf(buf, size, "%.1f h", seconds / 3600);
+    else
+        snprintf(buf, size, "%.1f days", seconds / 86400);
+}
+
+// ImGui 1.80 scrolls the hovered window with the mouse wheel in NewFrame(),
+// before any item can claim the wheel, and from the flags the windows had in
+// the previous frame. While the pointer is over a plot, the windows holding it
+// are flagged so the next wheel only zooms; Begin() resets the flags.
+static void claimMouseWheel()
+{
+    for (ImGuiWindow *window = ImGui::GetCurrentWindow(); window != nullptr; window = window->ParentWindow)
+    {
+        window->Flags |= ImGuiWindowFlags_NoScrollWithMouse;
+        if (!(window->Flags & ImGuiWindowFlags_ChildWindow))
+            break;
+    }
+}
+
+/**
+ * Draws a history plot: for every pixel column, the min to max range of the
+ * buckets it covers and a line through their averages, newest on the right.
+ * The columns come from readHistoryColumns(), so a frame costs the width of
+ * the plot whatever the span. The mouse wheel zooms around the pointer,
+ * dragging pans back in time and unchecks animate, which freezes the plot;
+ * checking it again brings the right edge back to the current time. While
+ * animated, the store is read again at most fps times per second.
+ * A plot with quantiles marks the p50, p95 and p99 of the window.
+ *
+ * @param scale_limit The upper bound of the scale slider, 0 for a plot scaled on its values.
+ *                    A plot with a scale of 0 starts at the limit.
+ */
+static void drawHistoryPlot(HistoryPlot &plot, const Snapshot &snap, const char *overlay_text, float scale_limit)
+{
+    ImGui::PushID(plot.metric);
+    double now = time(nullptr) + 1; // the end of the current 1 s bucket
+    double retention = monitor_config.history_hours * 3600.0;
+    if (plot.span <= 0)
+    {
+        plot.span = HISTORY_PLOT_SPAN;
+        plot.end = now;
+    }
+    if (plot.fps <= 0)
+        plot.fps = HISTORY_PLOT_FPS;
+    if (ImGui::Checkbox("Animate", &plot.animate) && plot.animate)
+        plot.end = now;
+    if (plot.animate)
+        plot.end = now;
+    ImGui::SliderFloat("FPS", &plot.fps, 1, 60, "%.0f");
+    if (scale_limit > 0)
+    {
+        if (plot.scale <= 0)
+            plot.scale = scale_limit;
+        ImGui::SliderFloat("scale max", &plot.scale, 0, scale_limit);
+    }
+
+    ImVec2 size(max(ImGui::GetContentRegionAvail().x, 1.0f), 100);
+    ImGui::InvisibleButton("##history", size);
+    ImVec2 p0 = ImGui::GetItemRectMin(), p1 = ImGui::GetItemRectMax();
+    ImGuiIO &io = ImGui::GetIO();
+    int width = (int)size.x;
+    if (ImGui::IsItemHovered())
+        claimMouseWheel();
+    if (ImGui::IsItemHovered() && io.MouseWheel != 0)
+    {
+        // the time under the pointer stays under it
+        double right = (p1.x - io.MousePos.x) / size.x * plot.span;
+        double span = min(max(plot.span * pow(0.8, io.MouseWheel), HISTORY_PLOT_MIN_SPAN), retention);
+        if (!plot.animate)
+            plot.end += right / plot.span * span - right;
+        plot.span = span;
+    }
+    if (ImGui::IsItemActive() && io.MouseDelta.x != 0)
+    {
+        plot.animate = false;
+        plot.end = min(max(plot.end - io.MouseDelta.x / size.x * plot.span, now - retention), now);
+    }
+
+    // a change of the view reads the store at once, time passing and new samples at the fps
+    int series = findSeries(plot.metric);
+    double start = plot.end - plot.span;
+    bool view_changed = (int)plot.columns.size() != width || plot.span != plot.shown_span || (!plot.animate && start != plot.shown_start);
+    bool refresh_due = plot.animate && (start != plot.shown_start || snap.seq != plot.shown_seq) &&
+                       ImGui::GetTime() - plot.shown_time >= 1.0 / plot.fps;
+    if (view_changed || refresh_due)
+    {
+        plot.level = readHistoryColumns(series, start, plot.span, width, plot.columns);
+        if (plot.quantiles)
+            plot.quantile_count = historyQuantiles(series, start, plot.span, history_plot_quantiles, 3, plot.quantile_values);
+        plot.shown_start = start;
+        plot.shown_span = plot.span;
+        plot.shown_seq = snap.seq;
+        plot.shown_time = ImGui::GetTime();
+    }
+    start = plot.shown_start; // the columns drawn are the ones read
+
+    float scale_min = 0, scale_max = scale_limit > 0 ? plot.scale : 0;
+    if (scale_limit <= 0)
+    {
+        for (const HistoryPoint &c : plot.columns)
+            if (c.count)
+                scale_max = max(scale_max, c.max);
+    }
+    if (scale_max <= scale_min)
+        scale_max = scale_min + 1;
+
+    ImDrawList *draw = ImGui::GetWindowDrawList();
+    draw->AddRectFilled(p0, p1, ImGui::GetColorU32(ImGuiCol_FrameBg), ImGui::GetStyle().FrameRounding);
+    auto y = [&](float value) { return p1.y - (min(max(value, scale_min), scale_max) - scale_min) / (scale_max - scale_min) * size.y; };
+    ImU32 line = ImGui::GetColorU32(ImGuiCol_PlotLines);
+    ImU32 range = ImGui::GetColorU32(ImGuiCol_PlotLines, 0.35f);
+    // a bucket wider than a column leaves the columns up to the next one empty,
+    // only more empty columns than that are a gap in the values and break the line
+    int bucket_columns = (int)ceil(historyResolution(plot.level) / (plot.span / width));
+    ImVec2 prev;
+    int prev_x = -1;
+    for (int x = 0; x < width; x++)
+    {
+        const HistoryPoint &c = plot.columns[x];
+        if (c.count == 0)
+            continue;
+        float px = p0.x + x + 0.5f;
+        draw->AddLine(ImVec2(px, y(c.max)), ImVec2(px, y(c.min) + 1), range);
+        ImVec2 avg(px, y(c.sum / c.count));
+        if (prev_x >= 0 && x - prev_x <= bucket_columns)
+            draw->AddLine(prev, avg, line);
+        prev = avg;
+        prev_x = x;
+    }
+    if (plot.quantiles && plot.quantile_count)
+    {
+        ImU32 mark = ImGui::GetColorU32(ImGuiCol_PlotHistogram, 0.6f);
+        for (int q = 0; q < 3; q++)
+        {
+            float qy = y(plot.quantile_values[q]);
+            draw->AddLine(ImVec2(p0.x, qy), ImVec2(p1.x, qy), mark);
+            ImVec2 text = ImGui::CalcTextSize(history_plot_quantile_names[q]);
+            draw->AddText(ImVec2(p1.x - text.x - 2, max(qy - text.y, p0.y)), mark, history_plot_quantile_names[q]);
+        }
+    }
+    if (overlay_text != nullptr)
+        draw->AddText(ImVec2(p0.x + ImGui::GetStyle().FramePadding.x, p0.y + ImGui::GetStyle().FramePadding.y),
+                      ImGui::GetColorU32(ImGuiCol_Text), overlay_text);
+
+    if (ImGui::IsItemHovered() && !ImGui::IsItemActive())
+    {
+        int x = min(max((int)(io.MousePos.x - p0.x), 0), width - 1);
+        const HistoryPoint &c = plot.columns[x];
+        char ago[32];
+        formatSpan(plot.end - (start + (x + 0.5) * plot.span / width), ago, sizeof(ago));
+        if (c.count)
+            ImGui::SetTooltip("%s ago\navg %.2f  min %.2f  max %.2f", ago, c.sum / c.count, c.min, c.max);
+        else
+            ImGui::SetTooltip("%s ago\nno values", ago);
+    }
+    char span[32];
+    formatSpan(plot.span, span, sizeof(span));
+    ImGui::TextDisabled("%s at %d s per bucket, wheel to zoom, drag to pan", span, historyResolution(plot.level));
+    if (plot.quantiles && plot.quantile_count)
+        ImGui::Text("p50 %.4g  p95 %.4g  p99 %.4g over %llu samples", plot.quantile_values[0], plot.quantile_values[1],
+                    plot.quantile_values[2], plot.quantile_count);
+    ImGui::PopID();
+}
+
+/**
+ * Displays the CPU usage collected by the sampler thread using ImGui.
+ *
+ * The plot shows the history of the CPU usage over the span chosen, the animate checkbox freezes it. The scale slider controls the maximum value displayed on the plot. The CPU usage percentage is displayed as overlay text on the plot, the p50, p95 and p99 of the span as marks.
+ */
+void drawCPUTab(const Snapshot &snap)
+{
+    static HistoryPlot plot = {"cpu_usage", 100.0f, true, true};
+    char overlay_text[32];
+    sprintf(overlay_text, "CPU Usage: %.2f%%", snap.cpu_usage);
+    drawHistoryPlot(plot, snap, overlay_text, 100);
+
+    if (ImGui::TreeNode("Cores"))
+    {
+        for (size_t i = 0; i < snap.core_usage.size(); i++)
+        {
+            char core_overlay[32];
+            sprintf(core_overlay, "cpu%zu: %.1f%%", i, snap.core_usage[i]);
+            ImGui::ProgressBar(snap.core_usage[i] / 100.0f, ImVec2(-1.0f, 0.0f), core_overlay);
+        }
+        ImGui::TreePop();
+    }
+}
+
+/**
+ * Displays fan statistics using ImGui.
+ * The fan speed and level are taken from the snapshot collected by the sampler thread.
+ * It then displays the fan status, level, and speed in RPM using ImGui.
+ * The history of the fan speed is plotted below, with options to freeze it and adjust the span and scale.
+ */
+void drawFanTab(const Snapshot &snap)
+{
+    static HistoryPlot plot = {"fan_speed", 2000.0f, true};
+    const char *status_fan = (snap.fan_speed > 0 ) ? "enabled" : "disabled";
+
+    ImGui::Text("Status: %s         Level: %s         Speed: %.0f RPM", status_fan, snap.fan_level.c_str(), snap.fan_speed);
+    char overlay_text[32];
+    sprintf(overlay_text, "Speed: %.0f RPM", snap.fan_speed);
+    drawHistoryPlot(plot, snap, overlay_text, 10000);
+}
+
+/**
+ * Displays the CPU temperature collected by the sampler thread using ImGui.
+ * Allows the user to freeze the temperature history, choose its span, and scale the maximum value.
+ */
+void drawThermalTab(const Snapshot &snap)
+{
+    static HistoryPlot plot = {"cpu_temp", 100.0f, true, true};
+    ImGui::Text("Temperature: %.1f", snap.cpu_temp);
+    char overlay_text[32];
+    sprintf(overlay_text, "Temp: %.1f °C", snap.cpu_temp);
+    drawHistoryPlot(plot, snap, overlay_text, 100);
+}
+
+// Draw Container in system window
+void drawTabbedContainer(const Snapshot &snap)
+{
+    if(ImGui::BeginTabBar("##TabBar"))
+    {   
+        // CPU tabbed
+        if (ImGui::BeginTabItem("CPU"))
+        {
+            drawCPUTab(snap);
+            ImGui::EndTabItem();
+        }
+        // Fan tabbed
+        if (ImGui::BeginTabItem("Fan"))
+        {
+            ImGui::Text("Fan informations");
+            drawFanTab(snap);
+            ImGui::EndTabItem();
+        }
+        // Thermal tabbed
+        if (ImGui::BeginTabItem("Thermal"))
+        {
+            ImGui::Text("Thermal informations");
+            drawThermalTab(snap);
+            ImGui::EndTabItem();
+        }
+    ImGui::EndTabBar();
+    }
+}
+
+/**
+ * Displays the scheduling statistics of every collector of the sampler thread:
+ * its period, how many times it ran, how long the last run took against its
+ * cost estimate, the syscalls it made through the procfs layer and how late the
+ * runs started compared to their deadline. Hovering a collector lists its metrics.
+ */
+void drawSamplerStats(const Snapshot &snap)
+{
+    if (ImGui::TreeNode("Sampler"))
+    {
+        ImGui::Text("Snapshot #%llu", snap.seq);
+        if (ImGui::BeginTable("collectors", 9))
+        {
+            ImGui::TableSetupColumn("Collector");
+            ImGui::TableSetupColumn("Period");
+            ImGui::TableSetupColumn("Runs");
+            ImGui::TableSetupColumn("Last run");
+            ImGui::TableSetupColumn("Estimate");
+            ImGui::TableSetupColumn("Syscalls");
+            ImGui::TableSetupColumn("Jitter");
+            ImGui::TableSetupColumn("Jitter avg");
+            ImGui::TableSetupColumn("Jitter max");
+            ImGui::TableHeadersRow();
+
+            for (int i = 0; i < COLLECTOR_COUNT; i++)
+            {
+                const CollectorStats &stats = snap.collectors[i];
+                if (stats.name == nullptr)
+                    continue;
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%s", stats.name);
+                if (ImGui::IsItemHovered())
+                {
+                    ImGui::BeginTooltip();
+                    for (const Metric *metric = collectors[i].metrics; metric->name; metric++)
+                        ImGui::Text("%s (%s)", metric->name, metric->unit);
+                    ImGui::EndTooltip();
+                }
+                ImGui::TableSetColumnIndex(1);
+                if (stats.period_ms == 0)
+                    ImGui::Text("once");
+                else
+                    ImGui::Text("%d ms", stats.period_ms);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%llu", stats.runs);
+                ImGui::TableSetColumnIndex(3);
+                if (stats.last_duration_ms > stats.cost_ms)
+                    ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%.3f ms", stats.last_duration_ms);
+                else
+                    ImGui::Text("%.3f ms", stats.last_duration_ms);
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%.3f ms", stats.cost_ms);
+                ImGui::TableSetColumnIndex(5);
+                ImGui::Text("%llu", stats.syscalls);
+                ImGui::TableSetColumnIndex(6);
+                ImGui::Text("%.3f ms", stats.jitter_last_ms);
+                ImGui::TableSetColumnIndex(7);
+                ImGui::Text("%.3f ms", stats.jitter_avg_ms);
+                ImGui::TableSetColumnIndex(8);
+                ImGui::Text("%.3f ms", stats.jitter_max_ms);
+            }
+            ImGui::EndTable();
+        }
+        ImGui::TreePop();
+    }
+}
+
+// Formats a probe value, nanoseconds for the timing probes.
+static void formatProbeValue(char *out, size_t size, int probe, unsigned long long value)
+{
+    if (!probeIsTiming(probe))
+        snprintf(out, size, "%llu", value);
+    else if (value >= 1000000)
+        snprintf(out, size, "%.2f ms", value / 1e6);
+    else
+        snprintf(out, size, "%.1f us", value / 1e3);
+}
+
+/**
+ * Displays the cost of the monitor itself: its CPU and resident memory, and
+ * the p50, p99 and maximum of every probe since the start, the collector runs,
+ * the snapshot publication, the windows and the whole frame, with the syscalls
+ * and allocations per sample and the allocations per frame. The history store
+ * section gives the bytes per bucket of the closed blocks of every series,
+ * against the 16 bytes of a raw HistoryPoint.
+ */
+void drawOverhead(const Snapshot &snap, float frames_per_second)
+{
+    ImGui::Text("CPU: %.2f%%         RSS: %.1f MiB         Frames: %.1f/s", snap.monitor_cpu, snap.monitor_rss / 1024.0f,
+                frames_per_second);
+    if (ImGui::BeginTable("probes", 5))
+    {
+        ImGui::TableSetupColumn("Probe");
+        ImGui::TableSetupColumn("Count");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableSetupColumn("Max");
+        ImGui::TableHeadersRow();
+        for (int probe = 0; probe < PROBE_COUNT; probe++)
+        {
+            ProbeSummary summary = summarizeProbe(probe);
+            char text[32];
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%s", probeName(probe));
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%llu", summary.count);
+            ImGui::TableSetColumnIndex(2);
+            formatProbeValue(text, sizeof(text), probe, summary.p50);
+            ImGui::Text("%s", text);
+            ImGui::TableSetColumnIndex(3);
+            formatProbeValue(text, sizeof(text), probe, summary.p99);
+            ImGui::Text("%s", text);
+            ImGui::TableSetColumnIndex(4);
+            formatProbeValue(text, sizeof(text), probe, summary.max);
+            ImGui::Text("%s", text);
+        }
+        ImGui::EndTable();
+    }
+
+    if (ImGui::TreeNode("History store"))
+    {
+        ImGui::Text("Mapped: %.1f MiB, touched only where written", historyBytes() / 1048576.0f);
+        if (ImGui::BeginTable("history", 4))
+        {
+            ImGui::TableSetupColumn("Metric");
+            ImGui::TableSetupColumn("Closed buckets");
+            ImGui::TableSetupColumn("Stored");
+            ImGui::TableSetupColumn("Bytes/bucket");
+            ImGui::TableHeadersRow();
+            for (int series = 0; series < historySeriesCount(); series++)
+            {
+                size_t points, bytes;
+                historyCompression(series, points, bytes);
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%s", historySeriesName(series));
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%zu", points);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%.1f KiB", bytes / 1024.0f);
+                ImGui::TableSetColumnIndex(3);
+                if (points > 0)
+                    ImGui::Text("%.2f", (double)bytes / points);
+                else
+                    ImGui::Text("-");
+            }
+            ImGui::EndTable();
+        }
+        ImGui::TreePop();
+    }
+}
+
+// memory and processes window
+
+vector<int> selected_rows;
+
+/**
+ * Displays the memory statistics of the snapshot using ImGui.
+ */
+void drawMemory(const Snapshot &snap)
+{      
+       const Memory &mem = snap.mem;
+
+       char tr[20];
+       char ts[20];
+       sprintf(tr, "%.1f GiB", (float)mem.total_ram / 1024 / 1024);
+       sprintf(ts, "%d MiB", (int)mem.total_swap / 1024);
+
+       float ram_progress = (float)mem.used_ram / mem.total_ram;
+       char ram_values[50];
+       sprintf(ram_values, "%.1f GiB / %.1f GiB", (float)mem.used_ram / 1024 / 1024, (float)mem.total_ram / 1024 / 1024);
+
+       ImGui::Text("Physic Memory (RAM) :");
+       ImGui::Spacing();
+       ImGui::ProgressBar(ram_progress, ImVec2(-1.0f, 0.0f), ram_values);
+       ImGui::SetCursorPosY(ImGui::GetCursorPosY());
+       ImGui::Text("0 GiB");
+       ImGui::SameLine(0, ImGui::GetStyle().ItemInnerSpacing.x);
+       ImGui::SetCursorPosX(ImGui::GetContentRegionAvail().x - string(tr).size());
+       ImGui::SetCursorPosY(ImGui::GetCursorPosY());
+       ImGui::Text(tr);
+       ImGui::Spacing();
+       ImGui::Spacing();
+
+       float swap_progress = (float)mem.used_swap / mem.total_swap;
+       char swap_values[50];
+       sprintf(swap_values, "%lld MiB / %lld MiB", mem.used_swap, mem.total_swap / 1024);
+
+       ImGui::Text("Virtual Memory (SWAP) :");
+       ImGui::Spacing();
+       ImGui::ProgressBar(swap_progress, ImVec2(-1.0f, 0.0f), swap_values);
+       ImGui::SetCursorPosY(ImGui::GetCursorPosY());
+       ImGui::Text("0 MiB");
+       ImGui::SameLine(0, ImGui::GetStyle().ItemInnerSpacing.x);
+       ImGui::SetCursorPosX(ImGui::GetContentRegionAvail().x - string(tr).size());
+       ImGui::SetCursorPosY(ImGui::GetCursorPosY());
+       ImGui::Text(ts);
+       ImGui::Spacing();
+       ImGui::Spacing();
+
+       if (ImGui::TreeNode("Memory history"))
+       {
+              static HistoryPlot ram_plot = {"mem.used_ram", 0, true};
+              static HistoryPlot swap_plot = {"mem.used_swap", 0, true};
+              drawHistoryPlot(ram_plot, snap, "RAM (KiB)", mem.total_ram);
+              drawHistoryPlot(swap_plot, snap, "SWAP (KiB)", max(mem.total_swap, 1LL));
+              ImGui::TreePop();
+       }
+}
+
+/**
+ * Calculates the disk space usage progress from the snapshot
+ * and displays it using ImGui.
+ */
+void drawDiskUsage(const Snapshot &snap)
+{
+       if (snap.disk.total == 0)
+       {
+              return;
+       }
+
+       unsigned long disk_total = snap.disk.total;
+       unsigned long disk_used = snap.disk.used;
+
+       double disk_total_gb = (double)(disk_total) / (1024 * 1024 * 1024);
+       double disk_used_gb = (double)(disk_used) / (1024 * 1024 * 1024);
+       float disk_progress = (float)disk_used / (float)disk_total;
+
+       char ds[20];
+       char disk_values[50];
+       sprintf(ds, "%.f GiB", ceil(disk_total_gb));
+       sprintf(disk_values, "%.f GiB / %.f GiB", ceil(disk_used_gb), ceil(disk_total_gb));
+
+       ImGui::Text("Disk :");
+       ImGui::Spacing();
+       ImGui::ProgressBar(disk_progress, ImVec2(-1.0f, 0.0f), disk_values);
+       ImGui::SetCursorPosY(ImGui::GetCursorPosY());
+       ImGui::Text("0 GiB");
+       ImGui::SameLine(0, ImGui::GetStyle().ItemInnerSpacing.x);
+       ImGui::SetCursorPosX(ImGui::GetContentRegionAvail().x - string(ds).size());
+       ImGui::SetCursorPosY(ImGui::GetCursorPosY());
+       ImGui::Text(ds);
+       ImGui::Spacing();
+       ImGui::Spacing();
+}
+
+/**
+ * Displays the process table of the snapshot using ImGui.
+ * The process table includes information such as PID, name, state, CPU usage, and memory usage.
+ * The table can be filtered by process name.
+ * The table is refreshed by the sampler thread.
+ */
+void drawProcessTable(const Snapshot &snap)
+{
+       if (ImGui::TreeNode("Process count history"))
+       {
+              static HistoryPlot plot = {"process_count", 0, true};
+              char overlay_text[32];
+              sprintf(overlay_text, "%d processes", snap.process_count);
+              drawHistoryPlot(plot, snap, overlay_text, 0);
+              ImGui::TreePop();
+       }
+       if (ImGui::TreeNode("Process Table"))
+       {
+              ImGui::Text("Filter the process by name:");
+              static ImGuiTextFilter filter;
+              bool filter_changed = filter.Draw();
+
+              // Rows passing the filter, only rebuilt when a new snapshot or filter arrives
+              static vector<int> rows;
+              static unsigned long long rows_seq = 0;
+              if (filter_changed || rows_seq != snap.seq)
+              {
+                     rows_seq = snap.seq;
+                     rows.clear();
+                     for (size_t i = 0; i < snap.processes.size(); i++)
+                     {
+                            if (filter.PassFilter(snap.processes[i].name))
+                                   rows.push_back(i);
+                     }
+              }
+
+              if (ImGui::BeginTable("proc", 5))
+              {
+                     ImGui::TableSetupColumn("PID");
+                     ImGui::TableSetupColumn("NAME");
+                     ImGui::TableSetupColumn("STATE");
+                     ImGui::TableSetupColumn("CPU");
+                     ImGui::TableSetupColumn("MEM v/o");
+                     ImGui::TableHeadersRow();
+
+                     // only the visible rows are built, whatever the number of processes
+                     ImGuiListClipper clipper;
+                     clipper.Begin(rows.size());
+                     while (clipper.Step())
+                     {
+                            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+                            {
+                                   const Proc &process = snap.processes[rows[row]];
+                                   ImGui::TableNextRow();
+                                   ImGui::TableSetColumnIndex(0);
+                                   bool is_selected = (find(selected_rows.begin(), selected_rows.end(), process.pid) != selected_rows.end());
+                                   char pid_label[16];
+                                   sprintf(pid_label, "%d", process.pid);
+                                   if (ImGui::Selectable(pid_label, is_selected, ImGuiSelectableFlags_SpanAllColumns))
+                                   {
+                                          if (is_selected)
+                                          {
+                                                 selected_rows.erase(remove(selected_rows.begin(), selected_rows.end(), process.pid), selected_rows.end());
+                                          }
+                                          else
+                                          {
+                                                 selected_rows.push_back(process.pid);
+                                          }
+                                   }
+                                   ImGui::TableSetColumnIndex(1);
+                                   ImGui::Text("%s", process.name);
+                                   ImGui::TableSetColumnIndex(2);
+                                   ImGui::Text("%c", process.state);
+                                   ImGui::TableSetColumnIndex(3);
+                                   ImGui::Text("%.2f", process.cpu_usage);
+                                   ImGui::TableSetColumnIndex(4);
+                                   ImGui::Text("%.2f", process.memory_usage);
+                            }
+                     }
+                     ImGui::EndTable();
+              }
+              ImGui::TreePop();
+       }
+}
+
+// Process creation rates and recently exited processes, from the proc connector.
+void drawProcessEvents(const Snapshot &snap)
+{
+       const ProcEvents &events = snap.proc_events;
+       if (!events.active)
+              return;
+       if (ImGui::TreeNode("Process Events"))
+       {
+              ImGui::Text("Forks: %.1f/s   Execs: %.1f/s   Exits: %.1f/s", events.fork_rate, events.exec_rate, events.exit_rate);
+              ImGui::Text("Since start: %llu forks, %llu execs, %llu exits", events.forks, events.execs, events.exits);
+              if (ImGui::BeginTable("exited", 5, ImGuiTableFlags_ScrollY, ImVec2(0, 200)))
+              {
+                     ImGui::TableSetupColumn("PID");
+                     ImGui::TableSetupColumn("NAME");
+                     ImGui::TableSetupColumn("CPU TIME");
+                     ImGui::TableSetupColumn("STATUS");
+                     ImGui::TableSetupColumn("EXITED");
+                     ImGui::TableHeadersRow();
+                     for (const ExitedProc &proc : events.exited)
+                     {
+                            ImGui::TableNextRow();
+                            ImGui::TableSetColumnIndex(0);
+                            ImGui::Text("%d", proc.pid);
+                            ImGui::TableSetColumnIndex(1);
+                            ImGui::Text("%s", proc.name[0] ? proc.name : "?");
+                            ImGui::TableSetColumnIndex(2);
+                            if (proc.cpu_seconds >= 0)
+                                   ImGui::Text("%.2f s", proc.cpu_seconds);
+                            else
+                                   ImGui::Text("?");
+                            ImGui::TableSetColumnIndex(3);
+                            if (proc.exit_code & 0x7f)
+                                   ImGui::Text("signal %d", proc.exit_code & 0x7f);
+                            else
+                                   ImGui::Text("exit %d", (proc.exit_code >> 8) & 0xff);
+                            ImGui::TableSetColumnIndex(4);
+                            char when[16];
+                            strftime(when, sizeof(when), "%H:%M:%S", localtime(&proc.time));
+                            ImGui::Text("%s", when);
+                     }
+                     ImGui::EndTable();
+              }
+              ImGui::TreePop();
+       }
+}
+
+// network window
+
+// Displays the IPv4 addresses collected by getIpv4Network.
+void drawIpv4Network(const Networks &networks)
+{
+    ImGui::Spacing();
+    ImGui::Text("IPV4 Network:");
+    for (const IP4 &ip : networks.ip4s)
+    {
+        ImGui::Text("   %s : %s", ip.name, ip.addressBuffer);
+    }
+}
+
+// Displays the interfaces with their state and addresses, and the log of their changes.
+void drawLinks(const Networks &networks)
+{
+    if (networks.links.empty())
+        return;
+    if (ImGui::TreeNode("Interfaces"))
+    {
+        if (ImGui::BeginTable("links", 3))
+        {
+            ImGui::TableSetupColumn("Interface");
+            ImGui::TableSetupColumn("State");
+            ImGui::TableSetupColumn("Addresses");
+            ImGui::TableHeadersRow();
+            for (const Link &link : networks.links)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%s", link.name);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%s", !link.up ? "down" : link.carrier ? "up" : "no carrier");
+                ImGui::TableSetColumnIndex(2);
+                for (const LinkAddress &address : link.addresses)
+                    ImGui::Text("%s/%d", address.address, address.prefix);
+            }
+            ImGui::EndTable();
+        }
+        ImGui::TreePop();
+    }
+    if (ImGui::TreeNode("Interface events"))
+    {
+        // newest first
+        for (auto it = networks.events.rbegin(); it != networks.events.rend(); ++it)
+        {
+            char when[16];
+            struct tm tm;
+            localtime_r(&it->time.tv_sec, &tm);
+            strftime(when, sizeof(when), "%H:%M:%S", &tm);
+            ImGui::Text("%s.%03ld  %s", when, it->time.tv_nsec / 1000000, it->text);
+        }
+        ImGui::TreePop();
+    }
+}
+
+/*
+* This function uses ImGui to create a table called "TX" with 9 columns.
+* The columns represent different network data metrics such as bytes, packets, errors, drops, etc.
+* The function then iterates over nets, which contains the interface counters read from rtnetlink (IFLA_STATS64), or from /proc/net/dev for captures, replays and non-live roots.
+* For each entry, the function adds a new row to the table and sets the values of each column using the corresponding data from the Net struct.
+*/
+void drawTXTable(const vector<Net> &nets)
+{
+    
+    if (ImGui::BeginTable("TX", 9))
+    {
+        ImGui::TableSetupColumn("Interface");
+        ImGui::TableSetupColumn("Bytes");
+        ImGui::TableSetupColumn("Packets");
+        ImGui::TableSetupColumn("Errs");
+        ImGui::TableSetupColumn("Drop");
+        ImGui::TableSetupColumn("Fifo");
+        ImGui::TableSetupColumn("Colls");
+        ImGui::TableSetupColumn("Carrier");
+        ImGui::TableSetupColumn("Compressed");
+        ImGui::TableHeadersRow();
+
+        for (const Net &datas : nets)
+        {
+            
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%s", datas.name);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%llu", datas.transmited.bytes);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%llu", datas.transmited.packets);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%llu", datas.transmited.errs);
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%llu", datas.transmited.drop);
+                ImGui::TableSetColumnIndex(5);
+                ImGui::Text("%llu", datas.transmited.fifo);
+                ImGui::TableSetColumnIndex(6);
+                ImGui::Text("%llu", datas.transmited.colls);
+                ImGui::TableSetColumnIndex(7);
+                ImGui::Text("%llu", datas.transmited.carrier);
+                ImGui::TableSetColumnIndex(8);
+                ImGui::Text("%llu", datas.transmited.compressed);
+        }
+        ImGui::EndTable();
+    }
+}
+
+/*
+ * This function uses ImGui to create a table called "RX" with 9 columns.
+ * The columns represent different network data metrics such as bytes, packets, errors, drops, etc.
+ * The function then iterates over nets, which contains the interface counters read from rtnetlink (IFLA_STATS64), or from /proc/net/dev for captures, replays and non-live roots.
+ * For each entry, the function adds a new row to the table and sets the values of each column using the corresponding data from the Net struct.
+ */
+void drawRXTable(const vector<Net> &nets)
+{
+    
+    if (ImGui::BeginTable("RX", 9))
+    {
+        ImGui::TableSetupColumn("Interface");
+        ImGui::TableSetupColumn("Bytes");
+        ImGui::TableSetupColumn("Packets");
+        ImGui::TableSetupColumn("Errs");
+        ImGui::TableSetupColumn("Drop");
+        ImGui::TableSetupColumn("Fifo");
+        ImGui::TableSetupColumn("Frame");
+        ImGui::TableSetupColumn("Compressed");
+        ImGui::TableSetupColumn("Multicast");
+        ImGui::TableHeadersRow();
+
+        for (const Net &datas : nets)
+        {
+            
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%s", datas.name);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%llu", datas.received.bytes);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%llu", datas.received.packets);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%llu", datas.received.errs);
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%llu", datas.received.drop);
+                ImGui::TableSetColumnIndex(5);
+                ImGui::Text("%llu", datas.received.fifo);
+                ImGui::TableSetColumnIndex(6);
+                ImGui::Text("%llu", datas.received.frame);
+                ImGui::TableSetColumnIndex(7);
+                ImGui::Text("%llu", datas.received.compressed);
+                ImGui::TableSetColumnIndex(8);
+                ImGui::Text("%llu", datas.received.multicast);
+        }
+        ImGui::EndTable();
+    }
+}
+
+/*
+* This function displays the network table of the snapshot.
+* The data is refreshed by the sampler thread through fillRXTXDatas().
+* The network table is displayed using ImGui::TreeNode and ImGui::TreePop functions.
+*/
+void drawNetworkTable(const Snapshot &snap)
+{
+    if(ImGui::TreeNode("Throughput history"))
+    {
+        static HistoryPlot rx_plot = {"rx_rate", 0, true, true};
+        static HistoryPlot tx_plot = {"tx_rate", 0, true, true};
+        char overlay_text[48];
+        sprintf(overlay_text, "RX: %.1f KiB/s", snap.rx_rate / 1024);
+        drawHistoryPlot(rx_plot, snap, overlay_text, 0);
+        sprintf(overlay_text, "TX: %.1f KiB/s", snap.tx_rate / 1024);
+        drawHistoryPlot(tx_plot, snap, overlay_text, 0);
+        ImGui::TreePop();
+    }
+    if(ImGui::TreeNode("Network table"))
+    {
+        if(ImGui::TreeNode("RX"))
+        {
+            drawRXTable(snap.nets);
+            ImGui::TreePop();
+        }
+        if(ImGui::TreeNode("TX"))
+        {
+            drawTXTable(snap.nets);
+            ImGui::TreePop();
+        }
+        ImGui::TreePop();
+    }
+}
+
+// draw Progress Bar with RX data.
+void drawRXProgress(const vector<Net> &nets)
+{
+    for (const Net &datas : nets)
+    {
+        char rx_overlay[50];
+        string unit;
+        long double rx_value = datas.received.bytes;
+
+        if (rx_value >= pow(1024, 3))
+        {
+            // rx_value /= pow(1000, 3); //value for wsl
+            rx_value /= pow(1024, 3);
+            unit = "GB";
+        }
+        else if (rx_value >= pow(1024, 2))
+        {
+            // rx_value /= pow(1000, 2); //value for wsl
+            rx_value /= pow(1024, 2);
+            unit = "MB";
+        }
+        else if (rx_value >= 1024)
+        {
+            // rx_value /= 1000; //value for wsl
+            rx_value /= 1024;
+            unit = "KB";
+        }
+        else
+        {
+            unit = "bytes";
+        }
+
+        sprintf(rx_overlay, "%.2Lf %s", rx_value, unit.c_str());
+        long double rx_progress = (long double)datas.received.bytes / 2000000000.0;
+        ImGui::Text("%s", datas.name);
+        ImGui::Spacing();
+        ImGui::ProgressBar(rx_progress, ImVec2(-1.0f, 0.0f), rx_overlay);
+        ImGui::SetCursorPosY(ImGui::GetCursorPosY());
+        ImGui::Text("0 GiB");
+        ImGui::SameLine(0, ImGui::GetStyle().ItemInnerSpacing.x);
+        ImGui::SetCursorPosX(ImGui::GetContentRegionAvail().x - string("2.0GB").size());
+        ImGui::SetCursorPosY(ImGui::GetCursorPosY());
+        ImGui::Text("2.0GB");
+        ImGui::Spacing();
+        ImGui::Spacing();
+    }
+}
+
+// draw Progress Bar with TX data.
+void drawTXProgress(const vector<Net> &nets)
+{
+    for (const Net &datas : nets)
+    {
+        char tx_overlay[50];
+        string unit;
+        long double tx_value = datas.transmited.bytes;
+
+        if (tx_value >= pow(1024, 3))
+        {
+            // tx_value /= pow(1000, 3); //value for wsl
+            tx_value /= pow(1024, 3); 
+            unit = "GB";
+        }
+        else if (tx_value >= pow(1024, 2))
+        {
+            // tx_value /= pow(1000, 2); //value for wsl
+            tx_value /= pow(1024, 2);
+            unit = "MB";
+        }
+        else if (tx_value >= 1024)
+        {
+            // tx_value /= 1000; //value for wsl
+            tx_value /= 1024;
+            unit = "KB";
+        }
+        else
+        {
+            unit = "bytes";
+        }
+
+        sprintf(tx_overlay, "%.2Lf %s", tx_value, unit.c_str());
+        long double tx_progress = (long double)datas.transmited.bytes / 2000000000.0;
+        ImGui::Text("%s", datas.name);
+        ImGui::Spacing();
+        ImGui::ProgressBar(tx_progress, ImVec2(-1.0f, 0.0f), tx_overlay);
+        ImGui::SetCursorPosY(ImGui::GetCursorPosY());
+        ImGui::Text("0 GiB");
+        ImGui::SameLine(0, ImGui::GetStyle().ItemInnerSpacing.x);
+        ImGui::SetCursorPosX(ImGui::GetContentRegionAvail().x - string("2.0GB").size());
+        ImGui::SetCursorPosY(ImGui::GetCursorPosY());
+        ImGui::Text("2.0GB");
+        ImGui::Spacing();
+        ImGui::Spacing();
+    }
+}
+
+// Draw Container in network window
+void drawNetworkTabbed(const Snapshot &snap)
+{
+    if (ImGui::BeginTabBar("##TabBar"))
+    {
+        // RX tabbed
+        if (ImGui::BeginTabItem("Receive(RX)"))
+        {
+            drawRXProgress(snap.nets);
+            ImGui::EndTabItem();
+        }
+        // TX tabbed
+        if (ImGui::BeginTabItem("Transmit(TX)"))
+        {
+            drawTXProgress(snap.nets);
+            ImGui::EndTabItem();
+        }
+        ImGui::EndTabBar();
+    }
+}